@@ -304,5 +304,230 @@ HnaMessageHeader::GetNetmask () const
     return m_netmask;
 }
 
+/* ===== OgmTlvHeader Implementation ===== */
+
+NS_OBJECT_ENSURE_REGISTERED (OgmTlvHeader);
+
+OgmTlvHeader::OgmTlvHeader ()
+    : m_valid (true)
+{
+}
+
+OgmTlvHeader::~OgmTlvHeader ()
+{
+}
+
+TypeId
+OgmTlvHeader::GetTypeId (void)
+{
+    static TypeId tid = TypeId ("ns3::batman::OgmTlvHeader")
+        .SetParent<Header> ()
+        .SetGroupName ("Batman")
+        .AddConstructor<OgmTlvHeader> ()
+    ;
+    return tid;
+}
+
+TypeId
+OgmTlvHeader::GetInstanceTypeId (void) const
+{
+    return GetTypeId ();
+}
+
+void
+OgmTlvHeader::Print (std::ostream &os) const
+{
+    os << "OGM/TLV: orig=" << GetOriginatorAddress ()
+       << " seqno=" << m_message.seqno_
+       << " ttl=" << (uint32_t)m_message.ttl_
+       << " flags=" << (uint32_t)m_message.flags_
+       << " hna=" << m_message.hna_.size ();
+    if (m_message.has_tq_)
+    {
+        os << " tq=" << (uint32_t)m_message.tq_;
+    }
+}
+
+uint32_t
+OgmTlvHeader::GetSerializedSize (void) const
+{
+    return tlvSize (m_message);
+}
+
+void
+OgmTlvHeader::Serialize (Buffer::Iterator start) const
+{
+    std::vector<uint8_t> bytes (tlvSize (m_message));
+    tlvEncode (m_message, &bytes[0]);
+    start.Write (&bytes[0], bytes.size ());
+}
+
+uint32_t
+OgmTlvHeader::Deserialize (Buffer::Iterator start)
+{
+    Buffer::Iterator i = start;
+    uint32_t remaining = start.GetRemainingSize ();
+    m_message = TlvMessage ();
+    m_valid = false;
+    
+    // A truncated or forged frame consumes the rest of the buffer
+    if (remaining < BATMAN_TLV_FIXED_LEN)
+    {
+        NS_LOG_WARN ("Truncated OGM");
+        return remaining;
+    }
+    
+    // The fixed part ends with the length of the extension block
+    std::vector<uint8_t> bytes (BATMAN_TLV_FIXED_LEN);
+    i.Read (&bytes[0], BATMAN_TLV_FIXED_LEN);
+    uint16_t extLen = tlvGet16 (&bytes[BATMAN_TLV_FIXED_LEN - 2]);
+    if (extLen > remaining - BATMAN_TLV_FIXED_LEN)
+    {
+        NS_LOG_WARN ("OGM extension block overruns the frame");
+        return remaining;
+    }
+    bytes.resize (BATMAN_TLV_FIXED_LEN + extLen);
+    if (extLen > 0)
+    {
+        i.Read (&bytes[BATMAN_TLV_FIXED_LEN], extLen);
+    }
+    
+    if (tlvDecode (&bytes[0], bytes.size (), m_message) == 0)
+    {
+        NS_LOG_WARN ("Malformed OGM extension block");
+        m_message = TlvMessage ();
+        return bytes.size ();
+    }
+    m_valid = true;
+    return bytes.size ();
+}
+
+bool
+OgmTlvHeader::IsValid () const
+{
+    return m_valid;
+}
+
+void
+OgmTlvHeader::SetFlags (uint8_t flags)
+{
+    m_message.flags_ = flags;
+}
+
+uint8_t
+OgmTlvHeader::GetFlags () const
+{
+    return m_message.flags_;
+}
+
+void
+OgmTlvHeader::SetTtl (uint8_t ttl)
+{
+    m_message.ttl_ = ttl;
+}
+
+uint8_t
+OgmTlvHeader::GetTtl () const
+{
+    return m_message.ttl_;
+}
+
+void
+OgmTlvHeader::SetSeqNo (uint16_t seqno)
+{
+    m_message.seqno_ = seqno;
+}
+
+uint16_t
+OgmTlvHeader::GetSeqNo () const
+{
+    return m_message.seqno_;
+}
+
+void
+OgmTlvHeader::SetOriginatorAddress (Ipv4Address address)
+{
+    m_message.orig_ = address.Get ();
+}
+
+Ipv4Address
+OgmTlvHeader::GetOriginatorAddress () const
+{
+    return Ipv4Address (m_message.orig_);
+}
+
+void
+OgmTlvHeader::SetGatewayFlags (uint8_t flags)
+{
+    m_message.gw_flags_ = flags;
+}
+
+uint8_t
+OgmTlvHeader::GetGatewayFlags () const
+{
+    return m_message.gw_flags_;
+}
+
+void
+OgmTlvHeader::SetGatewayPort (uint16_t port)
+{
+    m_message.gw_port_ = port;
+}
+
+uint16_t
+OgmTlvHeader::GetGatewayPort () const
+{
+    return m_message.gw_port_;
+}
+
+void
+OgmTlvHeader::AddHna (Ipv4Address network, uint8_t netmask)
+{
+    m_message.hna_.push_back (std::make_pair (network.Get (), netmask));
+}
+
+uint32_t
+OgmTlvHeader::GetHnaCount () const
+{
+    return m_message.hna_.size ();
+}
+
+Ipv4Address
+OgmTlvHeader::GetHnaNetwork (uint32_t i) const
+{
+    return Ipv4Address (m_message.hna_[i].first);
+}
+
+uint8_t
+OgmTlvHeader::GetHnaNetmask (uint32_t i) const
+{
+    return m_message.hna_[i].second;
+}
+
+void
+OgmTlvHeader::SetTq (uint8_t tq)
+{
+    m_message.has_tq_ = true;
+    m_message.tq_ = tq;
+}
+
+bool
+OgmTlvHeader::HasTq () const
+{
+    return m_message.has_tq_;
+}
+
+uint8_t
+OgmTlvHeader::GetTq () const
+{
+    return m_message.tq_;
+}
+
+const TlvMessage&
+OgmTlvHeader::GetMessage () const
+{
+    return m_message;
+}
+
 } // namespace batman
 } // namespace ns3
@@ -13,6 +13,9 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/nstime.h"
 #include <iostream>
+#include <vector>
+
+#include "batman_tlv.h"
 
 namespace ns3 {
 namespace batman {
@@ -183,6 +186,77 @@ private:
     static const uint8_t UNIDIRECTIONAL_FLAG = 0x20;
 };
 
+/**
+ * \ingroup batman
+ * \brief Variable-length OGM with extensions (version BATMAN_TLV_VERSION)
+ *
+ * Carries the OGM fields together with the originator's HNA list, an
+ * optional TQ and unknown extensions, framed as described in
+ * batman_tlv.h. The serialized size is exact: no padding, and HNA
+ * networks within the originator's /16 take three octets instead of five.
+ */
+class OgmTlvHeader : public Header
+{
+public:
+    OgmTlvHeader ();
+    virtual ~OgmTlvHeader ();
+
+    void SetFlags (uint8_t flags);
+    uint8_t GetFlags () const;
+    void SetTtl (uint8_t ttl);
+    uint8_t GetTtl () const;
+    void SetSeqNo (uint16_t seqno);
+    uint16_t GetSeqNo () const;
+    void SetOriginatorAddress (Ipv4Address address);
+    Ipv4Address GetOriginatorAddress () const;
+    void SetGatewayFlags (uint8_t flags);
+    uint8_t GetGatewayFlags () const;
+    void SetGatewayPort (uint16_t port);
+    uint16_t GetGatewayPort () const;
+    
+    /**
+     * \brief Append a network to the HNA list
+     * \param network the announced network address
+     * \param netmask the prefix length
+     */
+    void AddHna (Ipv4Address network, uint8_t netmask);
+    uint32_t GetHnaCount () const;
+    Ipv4Address GetHnaNetwork (uint32_t i) const;
+    uint8_t GetHnaNetmask (uint32_t i) const;
+    
+    /**
+     * \brief Attach the transmit quality extension
+     */
+    void SetTq (uint8_t tq);
+    bool HasTq () const;
+    uint8_t GetTq () const;
+    
+    /**
+     * \brief The decoded message, including unknown extensions
+     */
+    const TlvMessage& GetMessage () const;
+    
+    /**
+     * \brief Whether the last Deserialize decoded a well-formed message
+     *
+     * A truncated frame or a malformed extension block leaves the header
+     * invalid and its message reset; the OGM must be dropped.
+     */
+    bool IsValid () const;
+
+    // Inherited from Header
+    static TypeId GetTypeId (void);
+    virtual TypeId GetInstanceTypeId (void) const;
+    virtual void Print (std::ostream &os) const;
+    virtual uint32_t GetSerializedSize (void) const;
+    virtual void Serialize (Buffer::Iterator start) const;
+    virtual uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+    TlvMessage m_message;    ///< Fields and extensions
+    bool m_valid;            ///< Set by construction or a good Deserialize
+};
+
 /**
  * \ingroup batman
  * \brief Host Network Announcement (HNA) Header
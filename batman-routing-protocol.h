@@ -8,6 +8,7 @@
 #define BATMAN_ROUTING_PROTOCOL_H
 
 #include "batman-packet.h"
+#include "batman_core.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-interface.h"
 #include "ns3/inet-socket-address.h"
@@ -16,72 +17,66 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/timer.h"
 #include "ns3/node.h"
+#include "ns3/simulator.h"
 #include "ns3/socket.h"
 #include <map>
-#include <set>
 
 namespace ns3 {
 namespace batman {
 
-#define WINDOW_SIZE 128
-#define SEQNO_MAX 65535
 #define PURGE_TIMEOUT_FACTOR 10
 
 /**
  * \ingroup batman
- * \brief Neighbor information for an originator
+ * \brief FlatTable hashing policy for IPv4 addresses
  */
-class NeighborInfo
+struct Ipv4FlatIndex
 {
-public:
-    NeighborInfo ();
-    
-    Ipv4Address m_neighborAddr;
-    uint16_t m_currSeqNo;
-    std::set<uint16_t> m_slidingWindow;
-    uint32_t m_packetCount;
-    Time m_lastValidTime;
-    uint8_t m_lastTtl;
-    double m_tqValue;
-    
-    void UpdateWindow (uint16_t seqno);
-    bool IsInWindow (uint16_t seqno) const;
-    double CalculateTQ ();
+    static uint32_t hash (const Ipv4Address &addr)
+    {
+        uint32_t h = addr.Get () * 2654435769u;
+        return h ^ (h >> 16);
+    }
+    static size_t index (const Ipv4Address &addr)
+    {
+        return addr.Get ();
+    }
+    static uint32_t bits (const Ipv4Address &addr)
+    {
+        return addr.Get ();
+    }
 };
 
 /**
  * \ingroup batman
- * \brief Originator entry in routing table
+ * \brief Simulator time for the protocol core, in seconds
  */
-class OriginatorEntry
+struct Ns3Clock
 {
-public:
-    OriginatorEntry ();
-    ~OriginatorEntry ();
-    
-    Ipv4Address m_origAddr;
-    uint16_t m_currSeqNo;
-    Time m_lastAwareTime;
-    std::map<Ipv4Address, NeighborInfo*> m_neighborInfo;
-    Ipv4Address m_bestNextHop;
-    uint32_t m_bestRouteCount;
-    uint16_t m_bidirLinkSeqNo;
-    
-    // Gateway info
-    bool m_isGateway;
-    uint8_t m_gwFlags;
-    uint16_t m_gwPort;
-    
-    NeighborInfo* GetNeighborInfo (Ipv4Address neighbor);
-    void UpdateBestNextHop ();
-    void PurgeOldNeighbors (Time currentTime, Time timeout);
+    double now () const
+    {
+        return Simulator::Now ().GetSeconds ();
+    }
 };
 
+/**
+ * \ingroup batman
+ * \brief Protocol state (batman_core.h) for one node
+ *
+ * OGM reception, windowing, ranking, purge and lookup all live in the
+ * core; BatmanRoutingProtocol only parses and sends packets and runs
+ * the timers.
+ */
+typedef BatmanCore<Ipv4Address, Ns3Clock, Ipv4FlatIndex> BatmanState;
+typedef CoreNeighbor<Ipv4Address> NeighborInfo;
+typedef CoreOriginator<Ipv4Address> OriginatorEntry;
+
 /**
  * \ingroup batman
  * \brief B.A.T.M.A.N. Routing Protocol
  */
-class BatmanRoutingProtocol : public Ipv4RoutingProtocol
+class BatmanRoutingProtocol : public Ipv4RoutingProtocol,
+                              private CoreEvents<Ipv4Address>
 {
 public:
     static TypeId GetTypeId (void);
@@ -117,6 +112,16 @@ public:
     void SetTtl (uint8_t ttl);
     void SetGateway (uint8_t flags, uint16_t port);
     
+    /**
+     * \brief Get the currently selected gateway
+     *
+     * Maintained as gateway routes change; does not scan the table.
+     * \return the best gateway, or Ipv4Address () if there is none; test
+     *         with IsInitialized (), as Ipv4Address () is 102.102.102.102,
+     *         not GetAny ()
+     */
+    Ipv4Address SelectBestGateway () const;
+    
 protected:
     virtual void DoDispose ();
     virtual void DoInitialize ();
@@ -138,17 +143,8 @@ private:
     Ptr<Socket> m_socket;
     std::map<Ptr<Socket>, Ipv4InterfaceAddress> m_socketAddresses;
     
-    // Routing table
-    std::map<Ipv4Address, OriginatorEntry*> m_routingTable;
-    
-    // Broadcast log for duplicate detection
-    struct BroadcastLogEntry
-    {
-        Ipv4Address origAddr;
-        uint16_t seqNo;
-        Time timestamp;
-    };
-    std::list<BroadcastLogEntry> m_broadcastLog;
+    // Originators, neighbors, routes and the broadcast log
+    BatmanState m_state;
     
     // Timers
     Timer m_ogmTimer;
@@ -164,29 +160,19 @@ private:
     void ProcessOgm (Ptr<Packet> packet, Ipv4Address senderAddr);
     void ForwardOgm (Ptr<Packet> packet, Ipv4Address senderAddr);
     
-    // Packet validation
+    // Packet validation (format only; the core checks the rest)
     bool PreliminaryChecks (Ptr<Packet> packet, Ipv4Address senderAddr);
-    bool CheckDuplicate (Ipv4Address origAddr, uint16_t seqNo);
-    void LogBroadcast (Ipv4Address origAddr, uint16_t seqNo);
-    void PurgeBroadcastLog ();
-    
-    // Link checking
-    bool CheckBidirectionalLink (Ptr<Packet> packet, Ipv4Address senderAddr);
-    void UpdateBidirLinkSeqNo (Ipv4Address origAddr, uint16_t seqNo);
-    
-    // Route management
-    void UpdateNeighborRanking (Ipv4Address origAddr, Ipv4Address neighbor,
-                               uint16_t seqNo, uint8_t ttl);
-    OriginatorEntry* FindOriginator (Ipv4Address dest);
-    OriginatorEntry* AddOriginator (Ipv4Address dest);
-    void RemoveOriginator (Ipv4Address dest);
-    Ipv4Address Lookup (Ipv4Address dest);
-    
-    // Forwarding decision
-    bool ShouldForward (Ptr<Packet> packet, Ipv4Address senderAddr,
-                       Ipv4Address &nexthop);
-    
-    // Table maintenance
+    
+    // Core events
+    virtual void originatorAdded (const Ipv4Address &orig);
+    virtual void originatorRemoved (const Ipv4Address &orig);
+    virtual void routeChanged (const Ipv4Address &dest,
+                               const Ipv4Address &oldNextHop,
+                               const Ipv4Address &newNextHop, int count);
+    virtual void gatewayChanged (const Ipv4Address &oldGateway,
+                                 const Ipv4Address &newGateway);
+    
+    // Table maintenance, every PURGE_INTERVAL
     void PurgeRoutingTable ();
     
     // Utility functions
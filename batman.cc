@@ -8,11 +8,15 @@
 #include <ip.h>
 #include <random.h>
 #include <cmu-trace.h>
+#include <algorithm>
 
 /* Static packet offset initialization */
 int hdr_batman_ogm::offset_;
 int hdr_batman_hna::offset_;
 
+/* Histograms of every agent that enabled them, for merged dumps */
+std::vector<BatmanLatency*> BATMANAgent::all_latency_;
+
 /* Packet header class */
 static class BATMANHeaderClass : public PacketHeaderClass {
 public:
@@ -37,16 +41,25 @@ public:
 void OGMTimer::expire(Event *e) {
     agent_->sendOGM();
     
-    // Reschedule with jitter
-    double next_time = ORIGINATOR_INTERVAL + JITTER;
+    // Reschedule with jitter, stretched while the topology is stable
+    double next_time = agent_->nextOGMInterval() + JITTER;
+    agent_->next_ogm_time_ = CURRENT_TIME + next_time;
     resched(next_time);
 }
 
 void PurgeTimer::expire(Event *e) {
     agent_->purgeRoutingTable();
     
-    // Reschedule purge timer
-    resched(PURGE_TIMEOUT);
+    // Reschedule purge timer at the expiration wheel's tick
+    resched(PURGE_INTERVAL);
+}
+
+void AggregationTimer::expire(Event *e) {
+    agent_->sendAggregate();
+}
+
+void RecomputeTimer::expire(Event *e) {
+    agent_->rtable_->recompute();
 }
 
 /* ===== BATMANAgent Methods ===== */
@@ -54,8 +67,12 @@ void PurgeTimer::expire(Event *e) {
 BATMANAgent::BATMANAgent() : Agent(PT_BATMAN),
     ra_addr_(0), accessibility_(0), seqno_(0), ttl_value_(TTL_MAX),
     is_gateway_(false), gw_flags_(0), gw_port_(0),
-    ogm_timer_(this), purge_timer_(this),
-    port_dmux_(NULL), logtarget_(NULL)
+    ogm_interval_(ORIGINATOR_INTERVAL, ORIGINATOR_INTERVAL),
+    seen_changes_(0), next_ogm_time_(0),
+    ogm_timer_(this), purge_timer_(this), recompute_timer_(this),
+    agg_timer_(this), port_dmux_(NULL), logtarget_(NULL),
+    ogm_template_(NULL), agg_max_bytes_(0),
+    tlv_format_(false), latency_(NULL)
 {
     bind("accessibility_", &accessibility_);
     
@@ -65,6 +82,18 @@ BATMANAgent::BATMANAgent() : Agent(PT_BATMAN),
 
 BATMANAgent::~BATMANAgent() {
     delete rtable_;
+    
+    if (latency_ != NULL) {
+        all_latency_.erase(std::find(all_latency_.begin(),
+                                     all_latency_.end(), latency_));
+        delete latency_;
+    }
+    
+    if (ogm_template_ != NULL)
+        Packet::free(ogm_template_);
+    for (size_t i = 0; i < ogm_pool_.size(); i++) {
+        Packet::free(ogm_pool_[i]);
+    }
 }
 
 int BATMANAgent::command(int argc, const char*const* argv) {
@@ -72,13 +101,15 @@ int BATMANAgent::command(int argc, const char*const* argv) {
         if (strcasecmp(argv[1], "start") == 0) {
             // Start B.A.T.M.A.N. protocol
             ra_addr_ = getMyAddress();
+            rtable_->setAddress(ra_addr_);
             
             // Bind to BATMAN port
             port_dmux_ = new PortClassifier();
             
             // Start timers
-            ogm_timer_.resched(ORIGINATOR_INTERVAL + JITTER);
-            purge_timer_.resched(PURGE_TIMEOUT);
+            next_ogm_time_ = CURRENT_TIME + ORIGINATOR_INTERVAL + JITTER;
+            ogm_timer_.resched(next_ogm_time_ - CURRENT_TIME);
+            purge_timer_.resched(PURGE_INTERVAL);
             
             printf("BATMAN: Started on node %d\n", ra_addr_);
             return TCL_OK;
@@ -88,9 +119,92 @@ int BATMANAgent::command(int argc, const char*const* argv) {
             rtable_->print();
             return TCL_OK;
         }
+        
+        if (strcasecmp(argv[1], "ogm-rate") == 0) {
+            // Current OGMs per second under the adaptive interval
+            Tcl::instance().resultf("%g", ogm_interval_.rate());
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "print_mem") == 0) {
+            printf("BATMAN: Node %d routing state %lu bytes in use, "
+                   "%lu reserved\n", ra_addr_,
+                   (unsigned long)rtable_->bytesInUse(),
+                   (unsigned long)rtable_->bytesReserved());
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "stats") == 0) {
+            // Counters and table sizes as a list for "array set"
+            BatmanStats &st = rtable_->stats();
+            Tcl::instance().resultf(
+                "ogm_sent %llu ogm_received %llu ogm_duplicate %llu "
+                "ogm_unidirectional %llu ogm_forwarded %llu "
+                "data_forwarded %llu data_no_route %llu route_changes %llu "
+                "originators %lu routes %lu",
+                (unsigned long long)st.ogm_sent_,
+                (unsigned long long)st.ogm_received_,
+                (unsigned long long)st.ogm_duplicate_,
+                (unsigned long long)st.ogm_unidirectional_,
+                (unsigned long long)st.ogm_forwarded_,
+                (unsigned long long)st.data_forwarded_,
+                (unsigned long long)st.data_no_route_,
+                (unsigned long long)st.route_changes_,
+                (unsigned long)rtable_->size(),
+                (unsigned long)rtable_->fib().routes());
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "latency-histograms") == 0) {
+            // Time recvOGM, recvData and purges from here on
+            if (latency_ == NULL) {
+                latency_ = new BatmanLatency();
+                all_latency_.push_back(latency_);
+            }
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "latency-dump") == 0) {
+            if (latency_ != NULL) {
+                char prefix[64];
+                snprintf(prefix, sizeof(prefix), "BATMAN: Node %d latency ",
+                         ra_addr_);
+                latency_->print(stdout, prefix);
+            }
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "latency-reset") == 0) {
+            if (latency_ != NULL)
+                latency_->reset();
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "route-snapshots") == 0) {
+            // Publish route copies for lock-free lookupConcurrent readers
+            rtable_->enableSnapshots();
+            return TCL_OK;
+        }
     }
     
     if (argc == 3) {
+        if (strcasecmp(argv[1], "latency-dump") == 0 &&
+            strcasecmp(argv[2], "all") == 0) {
+            // Every agent's histograms merged, for the end of a run
+            BatmanLatency total;
+            for (size_t i = 0; i < all_latency_.size(); i++) {
+                total.merge(*all_latency_[i]);
+            }
+            total.print(stdout, "BATMAN: All nodes latency ");
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "stats") == 0 &&
+            strcasecmp(argv[2], "reset") == 0) {
+            rtable_->stats().reset();
+            return TCL_OK;
+        }
+        
         if (strcasecmp(argv[1], "log-target") == 0) {
             logtarget_ = (Trace*)TclObject::lookup(argv[2]);
             if (logtarget_ == NULL)
@@ -105,17 +219,91 @@ int BATMANAgent::command(int argc, const char*const* argv) {
             return TCL_OK;
         }
         
+        if (strcasecmp(argv[1], "dense-addressing") == 0) {
+            int num_nodes = atoi(argv[2]);
+            if (num_nodes < 0) {
+                fprintf(stderr, "BATMAN: Invalid node count %d\n", num_nodes);
+                return TCL_ERROR;
+            }
+            rtable_->enableDenseAddressing(num_nodes);
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "aggregation") == 0) {
+            int max_bytes = atoi(argv[2]);
+            if (max_bytes < 0) {
+                fprintf(stderr, "BATMAN: Invalid aggregate size %d\n", max_bytes);
+                return TCL_ERROR;
+            }
+            // Send what is queued under the old limit first
+            sendAggregate();
+            agg_max_bytes_ = max_bytes;
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "tlv-format") == 0) {
+            tlv_format_ = (atoi(argv[2]) != 0);
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "batch-recompute") == 0) {
+            double staleness = atof(argv[2]);
+            if (staleness < 0) {
+                fprintf(stderr, "BATMAN: Invalid staleness %f\n", staleness);
+                return TCL_ERROR;
+            }
+            rtable_->setBatchRecompute(staleness);
+            return TCL_OK;
+        }
+        
         if (strcasecmp(argv[1], "ttl") == 0) {
             ttl_value_ = atoi(argv[2]);
             if (ttl_value_ < TTL_MIN || ttl_value_ > TTL_MAX) {
                 fprintf(stderr, "BATMAN: Invalid TTL value %d\n", ttl_value_);
                 return TCL_ERROR;
             }
+            rtable_->setTtl(ttl_value_);
             return TCL_OK;
         }
     }
     
     if (argc == 4) {
+        if (strcasecmp(argv[1], "ogm-interval") == 0) {
+            double min = atof(argv[2]);
+            double max = atof(argv[3]);
+            if (min <= 0 || max < min) {
+                fprintf(stderr, "BATMAN: Invalid OGM interval %f..%f\n",
+                        min, max);
+                return TCL_ERROR;
+            }
+            ogm_interval_.setBounds(min, max);
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "fisheye") == 0) {
+            int radius = atoi(argv[2]);
+            int max_stride = atoi(argv[3]);
+            if (radius < 0 || max_stride < 1) {
+                fprintf(stderr, "BATMAN: Invalid fisheye scope %d/%d\n",
+                        radius, max_stride);
+                return TCL_ERROR;
+            }
+            rtable_->fisheye().configure(radius, max_stride);
+            return TCL_OK;
+        }
+        
+        if (strcasecmp(argv[1], "hna") == 0) {
+            int netmask = atoi(argv[3]);
+            if (netmask < 0 || netmask > 32) {
+                fprintf(stderr, "BATMAN: Invalid netmask %d\n", netmask);
+                return TCL_ERROR;
+            }
+            // Announced in TLV-format OGMs only
+            hna_list_.push_back(std::make_pair((nsaddr_t)atoi(argv[2]),
+                                               (u_int8_t)netmask));
+            return TCL_OK;
+        }
+        
         if (strcasecmp(argv[1], "gateway") == 0) {
             is_gateway_ = (atoi(argv[2]) != 0);
             gw_flags_ = atoi(argv[2]);
@@ -136,7 +324,12 @@ void BATMANAgent::recv(Packet *p, Handler*) {
     
     // Check if this is a BATMAN packet
     if (ch->ptype() == PT_BATMAN) {
-        recvOGM(p);
+        if (hdr_batman_ogm::access(p)->version() == BATMAN_TLV_VERSION)
+            recvTLV(p);
+        else if (p->datalen() > 0)
+            recvAggregate(p);
+        else
+            recvOGM(p);
     } else {
         // Data packet - route it
         recvData(p);
@@ -149,13 +342,20 @@ void BATMANAgent::sendOGM() {
     Packet *p = createOGM();
     
     if (p != NULL) {
+        if (tlv_format_)
+            encodeTLV(p);
+        
         // Log outgoing packet
         if (logtarget_) {
             log(p);
         }
+        rtable_->stats().ogm_sent_++;
         
-        // Send broadcast
-        send(p, 0);
+        // Send broadcast, or hand to the next aggregate frame
+        if (agg_max_bytes_ > 0)
+            queueOGM(p);
+        else
+            send(p, 0);
         
         // Update own sequence number
         seqno_++;
@@ -165,6 +365,36 @@ void BATMANAgent::sendOGM() {
 }
 
 Packet* BATMANAgent::createOGM() {
+    // Every own OGM is a copy of the template with its few varying fields
+    if (ogm_template_ == NULL)
+        ogm_template_ = buildOGMTemplate();
+    
+    Packet *p;
+    if (!ogm_pool_.empty()) {
+        p = ogm_pool_.back();
+        ogm_pool_.pop_back();
+    } else {
+        p = Packet::alloc();
+    }
+    memcpy(p->bits(), ogm_template_->bits(), Packet::hdrlen_);
+    
+    struct hdr_cmn *ch = HDR_CMN(p);
+    struct hdr_ip *ih = HDR_IP(p);
+    struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
+    
+    ch->uid() = uidcnt_++;
+    ch->timestamp() = CURRENT_TIME;
+    ih->ttl() = ttl_value_;
+    oh->flags() = 0;
+    oh->ttl() = ttl_value_;
+    oh->seqno() = seqno_;
+    oh->gw_flags() = gw_flags_;
+    oh->gw_port() = gw_port_;
+    
+    return p;
+}
+
+Packet* BATMANAgent::buildOGMTemplate() {
     Packet *p = allocpkt();
     struct hdr_cmn *ch = HDR_CMN(p);
     struct hdr_ip *ih = HDR_IP(p);
@@ -196,71 +426,53 @@ Packet* BATMANAgent::createOGM() {
     return p;
 }
 
+void BATMANAgent::recycleOGM(Packet *p) {
+    // Keep a few dropped OGMs for createOGM instead of freeing them
+    if (ogm_pool_.size() >= OGM_POOL_MAX) {
+        Packet::free(p);
+        return;
+    }
+    p->setdata(NULL);
+    ogm_pool_.push_back(p);
+}
+
 /* ===== OGM Reception ===== */
 
 void BATMANAgent::recvOGM(Packet *p) {
-    struct hdr_cmn *ch = HDR_CMN(p);
+    LatencyScope timed(latency_, LATENCY_RECV_OGM);
     struct hdr_ip *ih = HDR_IP(p);
     struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
     
     // Preliminary checks
     if (!preliminaryChecks(p)) {
-        Packet::free(p);
-        return;
-    }
-    
-    nsaddr_t sender = ih->saddr();
-    nsaddr_t originator = oh->orig_addr();
-    u_int16_t seqno = oh->seqno();
-    bool is_directlink = oh->is_directlink();
-    
-    // Check if this is our own OGM being echoed back
-    if (originator == ra_addr_) {
-        // This is our own OGM - update bidirectional link info
-        if (is_directlink) {
-            rtable_->updateBidirLinkSeqno(sender, seqno);
-        }
-        Packet::free(p);
+        recycleOGM(p);
         return;
     }
     
-    // Check for duplicate
-    if (checkDuplicate(originator, seqno)) {
-        // Duplicate - may still need to forward
-        if (shouldForward(p, sender)) {
-            forwardOGM(p);
-        } else {
-            Packet::free(p);
-        }
-        return;
-    }
-    
-    // Log this broadcast
-    logBroadcast(originator, seqno);
-    
-    // Check bidirectional link
-    bool bidir = checkBidirectionalLink(p);
-    if (!bidir) {
-        // Mark as unidirectional and don't process further
-        oh->set_unidirectional();
-        Packet::free(p);
-        return;
+    // Echoes, duplicates, the link check and ranking are the core's
+    CoreOgm<nsaddr_t> ogm;
+    ogm.sender_ = ih->saddr();
+    ogm.orig_ = oh->orig_addr();
+    ogm.seqno_ = oh->seqno();
+    ogm.ttl_ = oh->ttl();
+    ogm.flags_ = oh->flags();
+    ogm.gw_flags_ = oh->gw_flags();
+    ogm.gw_port_ = oh->gw_port();
+    if (logtarget_) {
+        logOGM(ogm);
     }
+    int verdict = rtable_->receiveOGM(ogm);
     
-    // Update neighbor ranking
-    updateNeighborRanking(p);
-    
-    // Update gateway information if present
-    if (oh->gw_flags() != 0) {
-        rtable_->updateGateway(originator, oh->gw_flags(), oh->gw_port());
+    // TLV-format OGMs bundle the originator's HNA list
+    if ((verdict & OGM_ACCEPTED) && oh->version() == BATMAN_TLV_VERSION) {
+        updateHNA(p);
     }
     
     // Forward OGM if appropriate
-    nsaddr_t nexthop;
-    if (shouldForward(p, nexthop)) {
+    if (verdict & OGM_FORWARD) {
         forwardOGM(p);
     } else {
-        Packet::free(p);
+        recycleOGM(p);
     }
 }
 
@@ -274,7 +486,7 @@ void BATMANAgent::forwardOGM(Packet *p) {
     ih->ttl()--;
     
     if (oh->ttl() == 0) {
-        Packet::free(p);
+        recycleOGM(p);
         return;
     }
     
@@ -290,158 +502,238 @@ void BATMANAgent::forwardOGM(Packet *p) {
     ih->saddr() = ra_addr_;
     ih->daddr() = IP_BROADCAST;
     
+    // A TLV message keeps TTL and flags at fixed offsets; patch in place
+    if (oh->version() == BATMAN_TLV_VERSION && p->datalen() > 0) {
+        p->accessdata()[BATMAN_TLV_OFFSET_FLAGS] = oh->flags();
+        p->accessdata()[BATMAN_TLV_OFFSET_TTL] = oh->ttl();
+    }
+    
     // Add small random delay to avoid collisions
     double delay = Random::uniform(BROADCAST_DELAY_MAX);
+    if (latency_ != NULL && agg_max_bytes_ == 0) {
+        (*latency_)[LATENCY_FORWARD_DELAY].record((uint64_t)(delay * 1e9));
+    }
     
     // Log forwarding
     if (logtarget_) {
         log(p);
     }
+    rtable_->stats().ogm_forwarded_++;
+    
+    // Aggregation applies its own bounded delay, timed when the frame goes
+    if (agg_max_bytes_ > 0) {
+        queueOGM(p);
+        if (latency_ != NULL)
+            agg_forwarded_.push_back(CURRENT_TIME);
+        return;
+    }
     
     // Schedule send with delay
     Scheduler::instance().schedule(this, p, delay);
 }
 
-/* ===== Packet Processing ===== */
+/* ===== OGM Aggregation ===== */
 
-bool BATMANAgent::preliminaryChecks(Packet *p) {
-    struct hdr_cmn *ch = HDR_CMN(p);
-    struct hdr_ip *ih = HDR_IP(p);
+void BATMANAgent::queueOGM(Packet *p) {
     struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
+    bool tlv = (oh->version() == BATMAN_TLV_VERSION);
+    size_t ogm_len = tlv ? p->datalen() : sizeof(hdr_batman_ogm);
     
-    // Check version
-    if (oh->version() != BATMAN_VERSION) {
-        trace("BATMAN: Version mismatch, dropping packet");
-        return false;
+    // Close the current frame if this OGM would overflow it
+    size_t queued = queuedBytes();
+    if (queued > 0 && queued + ogm_len > (size_t)agg_max_bytes_) {
+        sendAggregate();
     }
     
-    // Check if sender is ourselves
-    if (ih->saddr() == ra_addr_) {
-        return false;
+    if (tlv) {
+        agg_tlv_.insert(agg_tlv_.end(), p->accessdata(),
+                        p->accessdata() + ogm_len);
+    } else {
+        agg_queue_.push_back(*oh);
     }
+    recycleOGM(p);
     
-    // Check if sender address is broadcast
-    if (ih->saddr() == IP_BROADCAST) {
-        return false;
-    }
+    // The first OGM of a frame starts the jittered send delay
+    if (queuedBytes() == ogm_len)
+        agg_timer_.resched(Random::uniform(MAX_AGGREGATION_DELAY));
+}
+
+size_t BATMANAgent::queuedBytes() {
+    return agg_queue_.size() * sizeof(hdr_batman_ogm) + agg_tlv_.size();
+}
+
+void BATMANAgent::sendAggregate() {
+    if (agg_timer_.status() == TimerHandler::TIMER_PENDING)
+        agg_timer_.cancel();
     
-    // Check if originator is ourselves (except for bidirectional check)
-    if (oh->orig_addr() == ra_addr_) {
-        return true; // Allow for bidirectional link check
+    if (!agg_queue_.empty()) {
+        // First OGM in the header, the rest packed behind it as data
+        Packet *p = createOGM();
+        *hdr_batman_ogm::access(p) = agg_queue_[0];
+        
+        size_t ogm_len = sizeof(hdr_batman_ogm);
+        size_t extra = agg_queue_.size() - 1;
+        if (extra > 0) {
+            p->allocdata(extra * ogm_len);
+            memcpy(p->accessdata(), &agg_queue_[1], extra * ogm_len);
+        }
+        HDR_CMN(p)->size() = IP_HDR_LEN + agg_queue_.size() * ogm_len;
+        agg_queue_.clear();
+        
+        send(p, 0);
     }
     
-    // Check unidirectional flag
-    if (oh->is_unidirectional()) {
-        trace("BATMAN: Unidirectional link detected, dropping");
-        return false;
+    if (!agg_tlv_.empty()) {
+        // TLV messages are self-delimiting; all of them go in the data
+        Packet *p = createOGM();
+        TlvMessage first;
+        tlvDecode(&agg_tlv_[0], agg_tlv_.size(), first);
+        hdr_batman_ogm::access(p)->from_tlv(first);
+        
+        p->allocdata(agg_tlv_.size());
+        memcpy(p->accessdata(), &agg_tlv_[0], agg_tlv_.size());
+        HDR_CMN(p)->size() = IP_HDR_LEN + agg_tlv_.size();
+        agg_tlv_.clear();
+        
+        send(p, 0);
     }
     
-    return true;
-}
-
-bool BATMANAgent::checkDuplicate(nsaddr_t orig, u_int16_t seqno) {
-    // Search broadcast log
-    std::list<BroadcastLogEntry>::iterator it;
-    for (it = bcast_log_.begin(); it != bcast_log_.end(); ++it) {
-        if (it->orig_addr_ == orig && it->seqno_ == seqno) {
-            return true;
+    if (latency_ != NULL) {
+        LatencyHistogram &h = (*latency_)[LATENCY_FORWARD_DELAY];
+        for (size_t i = 0; i < agg_forwarded_.size(); i++) {
+            h.record((uint64_t)((CURRENT_TIME - agg_forwarded_[i]) * 1e9));
         }
     }
-    return false;
+    agg_forwarded_.clear();
 }
 
-void BATMANAgent::logBroadcast(nsaddr_t orig, u_int16_t seqno) {
-    bcast_log_.push_back(BroadcastLogEntry(orig, seqno, CURRENT_TIME));
-    purgeBroadcastLog();
+/* ===== TLV Wire Format ===== */
+
+void BATMANAgent::encodeTLV(Packet *p) {
+    struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
+    oh->version() = BATMAN_TLV_VERSION;
+    
+    TlvMessage m;
+    oh->to_tlv(m);
+    for (size_t i = 0; i < hna_list_.size(); i++) {
+        m.hna_.push_back(std::make_pair((u_int32_t)hna_list_[i].first,
+                                        hna_list_[i].second));
+    }
+    
+    size_t len = tlvSize(m);
+    p->allocdata(len);
+    tlvEncode(m, p->accessdata());
+    HDR_CMN(p)->size() = IP_HDR_LEN + len;
 }
 
-void BATMANAgent::purgeBroadcastLog() {
-    double timeout = PURGE_TIMEOUT;
+void BATMANAgent::recvTLV(Packet *p) {
+    const u_int8_t *data = p->accessdata();
+    size_t len = p->datalen();
+    
+    // One packet per message, each carrying only its own encoding
+    std::vector<Packet*> ogms;
+    size_t off = 0;
+    while (off < len) {
+        TlvMessage m;
+        size_t n = tlvDecode(data + off, len - off, m);
+        if (n == 0 || m.version_ != BATMAN_TLV_VERSION)
+            break;
+        
+        Packet *q = p->copy();
+        q->setdata(NULL);
+        hdr_batman_ogm::access(q)->from_tlv(m);
+        q->allocdata(n);
+        memcpy(q->accessdata(), data + off, n);
+        HDR_CMN(q)->size() = IP_HDR_LEN + n;
+        ogms.push_back(q);
+        off += n;
+    }
+    if (off < len)
+        trace("BATMAN: Malformed TLV message, rest of frame dropped");
+    recycleOGM(p);
     
-    std::list<BroadcastLogEntry>::iterator it = bcast_log_.begin();
-    while (it != bcast_log_.end()) {
-        if ((CURRENT_TIME - it->timestamp_) > timeout) {
-            bcast_log_.erase(it++);
-        } else {
-            ++it;
-        }
+    for (size_t i = 0; i < ogms.size(); i++) {
+        recvOGM(ogms[i]);
     }
 }
 
-bool BATMANAgent::checkBidirectionalLink(Packet *p) {
-    struct hdr_ip *ih = HDR_IP(p);
+void BATMANAgent::updateHNA(Packet *p) {
     struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
+    TlvMessage m;
+    if (p->datalen() == 0 || tlvDecode(p->accessdata(), p->datalen(), m) == 0)
+        return;
     
-    nsaddr_t sender = ih->saddr();
-    nsaddr_t originator = oh->orig_addr();
-    u_int16_t seqno = oh->seqno();
-    bool is_directlink = oh->is_directlink();
-    
-    // If this is a direct link OGM
-    if (is_directlink && sender == originator) {
-        // Check if we can find our own echoed OGM
-        return rtable_->checkBidirectionalLink(originator, sender, seqno);
+    std::vector<std::pair<nsaddr_t, u_int8_t> > hna;
+    for (size_t i = 0; i < m.hna_.size(); i++) {
+        hna.push_back(std::make_pair((nsaddr_t)m.hna_[i].first,
+                                     m.hna_[i].second));
     }
     
-    // For forwarded OGMs, assume bidirectional if the forwarder is bidirectional
-    return true;
+    // Only a changed list touches the forwarding table
+    OriginatorEntry *oe = rtable_->findOriginator(oh->orig_addr());
+    if (oe == NULL || oe->hna_list_ == hna)
+        return;
+    rtable_->removeHNA(oh->orig_addr());
+    for (size_t i = 0; i < hna.size(); i++) {
+        rtable_->addHNA(oh->orig_addr(), hna[i].first, hna[i].second);
+    }
 }
 
-void BATMANAgent::updateNeighborRanking(Packet *p) {
-    struct hdr_ip *ih = HDR_IP(p);
-    struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
-    
-    nsaddr_t sender = ih->saddr();
-    nsaddr_t originator = oh->orig_addr();
-    u_int16_t seqno = oh->seqno();
-    u_int8_t ttl = oh->ttl();
+void BATMANAgent::recvAggregate(Packet *p) {
+    size_t ogm_len = sizeof(hdr_batman_ogm);
+    size_t extra = p->datalen() / ogm_len;
+    
+    // Unpack each trailing OGM into a packet of its own
+    std::vector<Packet*> ogms;
+    for (size_t i = 0; i < extra; i++) {
+        Packet *q = p->copy();
+        memcpy(hdr_batman_ogm::access(q), p->accessdata() + i * ogm_len, ogm_len);
+        q->setdata(NULL);
+        HDR_CMN(q)->size() = IP_HDR_LEN + ogm_len;
+        ogms.push_back(q);
+    }
+    p->setdata(NULL);
+    HDR_CMN(p)->size() = IP_HDR_LEN + ogm_len;
     
-    // Update routing table with this information
-    rtable_->updateNeighborRanking(originator, sender, seqno, ttl);
+    recvOGM(p);
+    for (size_t i = 0; i < ogms.size(); i++) {
+        recvOGM(ogms[i]);
+    }
 }
 
-bool BATMANAgent::shouldForward(Packet *p, nsaddr_t &nexthop) {
+/* ===== Packet Processing ===== */
+
+bool BATMANAgent::preliminaryChecks(Packet *p) {
+    struct hdr_cmn *ch = HDR_CMN(p);
     struct hdr_ip *ih = HDR_IP(p);
     struct hdr_batman_ogm *oh = hdr_batman_ogm::access(p);
     
-    nsaddr_t sender = ih->saddr();
-    nsaddr_t originator = oh->orig_addr();
-    u_int16_t seqno = oh->seqno();
-    bool is_directlink = oh->is_directlink();
-    
-    // Forward if:
-    // 1. Received from single hop neighbor (direct link)
-    // 2. Received via best link AND (not duplicate OR same TTL as last)
+    // Check version
+    if (oh->version() != BATMAN_VERSION &&
+        oh->version() != BATMAN_TLV_VERSION) {
+        trace("BATMAN: Version mismatch, dropping packet");
+        return false;
+    }
     
-    OriginatorEntry *oe = rtable_->findOriginator(originator);
-    if (oe == NULL)
+    // Check if sender is ourselves
+    if (ih->saddr() == ra_addr_) {
         return false;
+    }
     
-    // Case 1: Direct link from originator
-    if (is_directlink && sender == originator) {
-        nexthop = IP_BROADCAST;
-        return true;
-    }
-    
-    // Case 2: Via best link
-    if (sender == oe->best_next_hop_) {
-        NeighborInfo *ni = oe->getNeighborInfo(sender);
-        if (ni != NULL) {
-            // Check if duplicate or not
-            if (!ni->isInWindow(seqno) || 
-                (oh->ttl() == ni->last_ttl_)) {
-                nexthop = IP_BROADCAST;
-                return true;
-            }
-        }
+    // Check if sender address is broadcast
+    if (ih->saddr() == IP_BROADCAST) {
+        return false;
     }
     
-    return false;
+    // Echoes of our own OGMs and flagged OGMs are left to the core, which
+    // counts them against the receptions it sees
+    return true;
 }
 
 /* ===== Data Packet Handling ===== */
 
 void BATMANAgent::recvData(Packet *p) {
+    LatencyScope timed(latency_, LATENCY_RECV_DATA);
     struct hdr_cmn *ch = HDR_CMN(p);
     struct hdr_ip *ih = HDR_IP(p);
     
@@ -454,15 +746,16 @@ void BATMANAgent::recvData(Packet *p) {
         return;
     }
     
-    // Look up next hop
-    nsaddr_t nexthop = rtable_->lookup(dest);
+    // Look up next hop in the forwarding table
+    nsaddr_t nexthop;
     
-    if (nexthop != 0) {
+    if (rtable_->fib().lookup(dest, nexthop) && nexthop != 0) {
         // Forward packet
         forwardData(p, nexthop);
     } else {
         // No route - drop packet
         trace("BATMAN: No route to %d, dropping packet", dest);
+        rtable_->stats().data_no_route_++;
         drop(p, DROP_RTR_NO_ROUTE);
     }
 }
@@ -486,6 +779,7 @@ void BATMANAgent::forwardData(Packet *p, nsaddr_t nexthop) {
     if (logtarget_) {
         log(p);
     }
+    rtable_->stats().data_forwarded_++;
     
     // Send packet
     send(p, 0);
@@ -494,7 +788,32 @@ void BATMANAgent::forwardData(Packet *p, nsaddr_t nexthop) {
 /* ===== Route Table Maintenance ===== */
 
 void BATMANAgent::purgeRoutingTable() {
-    rtable_->purge(CURRENT_TIME);
+    LatencyScope timed(latency_, LATENCY_PURGE);
+    rtable_->purge();
+}
+
+double BATMANAgent::nextOGMInterval() {
+    // Stable since the last OGM if the routing table reported nothing
+    u_int32_t changes = rtable_->topologyChanges();
+    bool changed = (changes != seen_changes_);
+    seen_changes_ = changes;
+    return ogm_interval_.next(changed);
+}
+
+void BATMANAgent::topologyChanged() {
+    if (!ogm_interval_.snapBack())
+        return;
+    
+    // Bring a stretched OGM forward to the fast rate
+    double delay = ogm_interval_.current() + JITTER;
+    if (next_ogm_time_ - CURRENT_TIME > delay) {
+        next_ogm_time_ = CURRENT_TIME + delay;
+        ogm_timer_.resched(delay);
+    }
+}
+
+void BATMANAgent::scheduleRecompute(double delay) {
+    recompute_timer_.resched(delay);
 }
 
 void BATMANAgent::updateRoutes() {
@@ -536,6 +855,23 @@ void BATMANAgent::log(Packet *p) {
     logtarget_->dump();
 }
 
+/* Reception record for tools/batman_replay */
+void BATMANAgent::logOGM(const CoreOgm<nsaddr_t> &ogm) {
+    sprintf(logtarget_->buffer(),
+            "O %.9f %d %d %d %d %d %d %d %d",
+            Scheduler::instance().clock(),
+            ra_addr_,
+            ogm.sender_,
+            ogm.orig_,
+            ogm.seqno_,
+            ogm.ttl_,
+            ogm.flags_,
+            ogm.gw_flags_,
+            ogm.gw_port_);
+    
+    logtarget_->dump();
+}
+
 nsaddr_t BATMANAgent::getMyAddress() {
     // Get node address from mobile node
     MobileNode *mn = getMobileNode();
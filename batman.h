@@ -15,6 +15,8 @@
 
 #include "batman_pkt.h"
 #include "batman_rtable.h"
+#include "batman_adaptive.h"
+#include "batman_histogram.h"
 
 #define CURRENT_TIME Scheduler::instance().clock()
 #define JITTER (Random::uniform(ORIGINATOR_INTERVAL_JITTER) - ORIGINATOR_INTERVAL_JITTER/2)
@@ -40,21 +42,30 @@ protected:
     BATMANAgent *agent_;
 };
 
-/* Broadcast buffer entry */
-class BroadcastLogEntry {
+/* Timer bounding how long a batched route recompute may wait */
+class RecomputeTimer : public TimerHandler {
 public:
-    nsaddr_t orig_addr_;
-    u_int16_t seqno_;
-    double timestamp_;
-    
-    BroadcastLogEntry(nsaddr_t addr, u_int16_t seqno, double time) :
-        orig_addr_(addr), seqno_(seqno), timestamp_(time) {}
+    RecomputeTimer(BATMANAgent *a) : TimerHandler(), agent_(a) {}
+    void expire(Event *e);
+protected:
+    BATMANAgent *agent_;
+};
+
+/* Timer bounding how long queued OGMs wait for an aggregate frame */
+class AggregationTimer : public TimerHandler {
+public:
+    AggregationTimer(BATMANAgent *a) : TimerHandler(), agent_(a) {}
+    void expire(Event *e);
+protected:
+    BATMANAgent *agent_;
 };
 
 /* B.A.T.M.A.N. Routing Agent */
 class BATMANAgent : public Agent {
     friend class OGMTimer;
     friend class PurgeTimer;
+    friend class RecomputeTimer;
+    friend class AggregationTimer;
     friend class BATMANRoutingTable;
     
 public:
@@ -80,51 +91,78 @@ protected:
     /* Routing table */
     BATMANRoutingTable *rtable_;
     
+    /* OGM interval, stretched while the topology is stable */
+    AdaptiveInterval ogm_interval_;
+    u_int32_t seen_changes_;    // rtable_->topologyChanges() at last OGM
+    double next_ogm_time_;
+    
     /* Timers */
     OGMTimer ogm_timer_;
     PurgeTimer purge_timer_;
+    RecomputeTimer recompute_timer_;
+    AggregationTimer agg_timer_;
     
     /* Port binding */
     PortClassifier *port_dmux_;
     Trace *logtarget_;
     
-    /* Broadcast log */
-    std::list<BroadcastLogEntry> bcast_log_;
+    /* Prebuilt own OGM and recycled OGM packets */
+    Packet *ogm_template_;
+    std::vector<Packet*> ogm_pool_;
+    
+    /* OGM aggregation (own and forwarded OGMs share one frame) */
+    std::vector<hdr_batman_ogm> agg_queue_;
+    std::vector<u_int8_t> agg_tlv_;    // Encoded TLV-format OGMs
+    std::vector<double> agg_forwarded_; // Queue times of forwarded OGMs
+    int agg_max_bytes_;         // 0 sends every OGM in its own frame
+    
+    /* TLV wire format and the networks announced with our OGMs */
+    bool tlv_format_;
+    std::vector<std::pair<nsaddr_t, u_int8_t> > hna_list_;
+    
+    /* Hot path latency histograms, NULL unless enabled */
+    BatmanLatency *latency_;
+    static std::vector<BatmanLatency*> all_latency_;   // Every agent's
     
     /* OGM Broadcasting */
     void sendOGM();
     void forwardOGM(Packet *p);
     Packet* createOGM();
+    Packet* buildOGMTemplate();
+    void recycleOGM(Packet *p);
+    void encodeTLV(Packet *p);
+    void queueOGM(Packet *p);
+    size_t queuedBytes();
+    void sendAggregate();
     
     /* Packet reception */
     void recvOGM(Packet *p);
+    void recvAggregate(Packet *p);
+    void recvTLV(Packet *p);
+    void updateHNA(Packet *p);
     void recvData(Packet *p);
     
-    /* Packet processing */
+    /* Packet processing (duplicates, links and ranking are the core's) */
     bool preliminaryChecks(Packet *p);
-    bool checkDuplicate(nsaddr_t orig, u_int16_t seqno);
-    void logBroadcast(nsaddr_t orig, u_int16_t seqno);
-    void purgeBroadcastLog();
-    
-    /* Bidirectional link check */
-    bool checkBidirectionalLink(Packet *p);
     
-    /* Neighbor ranking and routing */
-    void updateNeighborRanking(Packet *p);
+    /* Routing */
     void updateRoutes();
-    
-    /* Forwarding decision */
-    bool shouldForward(Packet *p, nsaddr_t &nexthop);
     void forwardData(Packet *p, nsaddr_t nexthop);
     
     /* Utility functions */
     void trace(char *fmt, ...);
     void log(Packet *p);
+    void logOGM(const CoreOgm<nsaddr_t> &ogm);
     nsaddr_t getMyAddress();
     MobileNode* getMobileNode();
     
+    /* Adaptive OGM interval */
+    double nextOGMInterval();
+    void topologyChanged();
+    
     /* Table maintenance */
     void purgeRoutingTable();
+    void scheduleRecompute(double delay);
 };
 
 #endif /* __batman_h__ */
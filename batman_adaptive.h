@@ -0,0 +1,63 @@
+/*
+ * batman_adaptive.h
+ * B.A.T.M.A.N. Adaptive OGM Interval
+ *
+ * Stretches the originator interval while the local topology is stable
+ * and snaps back to the fast rate as soon as it changes, so quasi-static
+ * parts of a mesh flood less without slowing convergence elsewhere.
+ */
+
+#ifndef __batman_adaptive_h__
+#define __batman_adaptive_h__
+
+/*
+ * The interval starts at min and grows by the growth factor after each
+ * OGM period without a topology change, up to max. Any change returns
+ * it to min. With min == max the interval is fixed. Peers judge link
+ * freshness by BI_LINK_TIMEOUT, so max should normally stay below it.
+ */
+class AdaptiveInterval {
+public:
+    AdaptiveInterval(double min, double max, double growth = 1.5) :
+        min_(min), max_(max), growth_(growth), current_(min) {}
+
+    void setBounds(double min, double max) {
+        min_ = min;
+        max_ = (max < min) ? min : max;
+        if (current_ < min_ || current_ > max_)
+            current_ = min_;
+    }
+
+    /* Interval until the next OGM, given whether the last one saw change */
+    double next(bool changed) {
+        if (changed) {
+            current_ = min_;
+        } else {
+            current_ *= growth_;
+            if (current_ > max_)
+                current_ = max_;
+        }
+        return current_;
+    }
+
+    /* Return to the fast rate; true if the interval was stretched */
+    bool snapBack() {
+        if (current_ <= min_)
+            return false;
+        current_ = min_;
+        return true;
+    }
+
+    double current() const { return current_; }
+    double rate() const { return 1.0 / current_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+
+private:
+    double min_;
+    double max_;
+    double growth_;
+    double current_;     // Interval in use, min_ <= current_ <= max_
+};
+
+#endif /* __batman_adaptive_h__ */
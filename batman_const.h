@@ -0,0 +1,32 @@
+/*
+ * batman_const.h
+ * B.A.T.M.A.N. Protocol Constants
+ *
+ * Constants shared by the protocol core and the simulator adapters.
+ * Based on RFC draft-openmesh-b-a-t-m-a-n-00
+ */
+
+#ifndef __batman_const_h__
+#define __batman_const_h__
+
+/* Protocol Constants */
+#define BATMAN_VERSION 4
+#define BATMAN_PORT 4305
+#define TTL_MIN 2
+#define TTL_MAX 255
+#define SEQNO_MAX 65535
+
+/* Timing Constants (in seconds) */
+#define ORIGINATOR_INTERVAL 1.0
+#define ORIGINATOR_INTERVAL_JITTER 0.2
+#define WINDOW_SIZE 128
+#define PURGE_TIMEOUT (10 * WINDOW_SIZE * ORIGINATOR_INTERVAL)
+#define BROADCAST_DELAY_MAX 0.1
+#define BI_LINK_TIMEOUT (3 * ORIGINATOR_INTERVAL)
+#define PURGE_INTERVAL ORIGINATOR_INTERVAL
+
+/* Flags */
+#define BATMAN_FLAG_DIRECTLINK 0x40
+#define BATMAN_FLAG_UNIDIRECTIONAL 0x20
+
+#endif /* __batman_const_h__ */
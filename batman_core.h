@@ -0,0 +1,905 @@
+/*
+ * batman_core.h
+ * B.A.T.M.A.N. Protocol Core
+ *
+ * Simulator-independent OGM processing: duplicate detection, the
+ * bidirectional link check, sliding windows, neighbor ranking, purge and
+ * route lookup. Templated on address type and clock, so the NS2 agent,
+ * the NS3 protocol and standalone tools all run the same code.
+ */
+
+#ifndef __batman_core_h__
+#define __batman_core_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "batman_const.h"
+#include "batman_window.h"
+#include "batman_dupcache.h"
+#include "batman_timer_wheel.h"
+#include "batman_flat_table.h"
+#include "batman_pool.h"
+#include "batman_small_vector.h"
+#include "batman_fib.h"
+#include "batman_gateway.h"
+#include "batman_rcu.h"
+#include "batman_fisheye.h"
+#include "batman_stats.h"
+
+/* Neighbor records kept inline per originator before spilling to the heap */
+#define NEIGHBOR_INLINE 4
+
+/* receiveOGM() verdict bits */
+#define OGM_ACCEPTED 0x01   // Counted towards the originator's ranking
+#define OGM_FORWARD 0x02    // To be rebroadcast
+
+/* Sequence number comparison considering wraparound */
+inline bool seqno_greater_than(uint16_t s1, uint16_t s2) {
+    return ((s1 > s2) && (s1 - s2 < SEQNO_MAX/2)) ||
+           ((s2 > s1) && (s2 - s1 > SEQNO_MAX/2));
+}
+
+inline bool seqno_less_than(uint16_t s1, uint16_t s2) {
+    return seqno_greater_than(s2, s1);
+}
+
+inline uint16_t seqno_diff(uint16_t s1, uint16_t s2) {
+    if (s1 >= s2)
+        return s1 - s2;
+    else
+        return (SEQNO_MAX - s2 + s1);
+}
+
+/*
+ * Addresses are value types with ==, != and <. Addr() stands for "no
+ * address": no next hop, no gateway. It is whatever the default
+ * constructor gives, so for ns-3's Ipv4Address it is 102.102.102.102,
+ * not GetAny(). A clock is any type with a double now() const returning
+ * seconds.
+ */
+
+/* Neighbor information for a specific originator */
+template <class Addr>
+class CoreNeighbor {
+public:
+    Addr neighbor_addr_;        // Address of the neighbor
+    uint16_t curr_seqno_;       // Current sequence number
+    uint16_t last_valid_seqno_; // Last valid sequence number
+    SeqnoWindow sliding_window_; // Bitmap of received seqnos
+    int packet_count_;          // Number of packets in window (popcount)
+    double last_valid_time_;    // Time of last valid OGM
+    uint8_t last_ttl_;          // TTL of last received OGM
+    double tq_value_;           // Transmit Quality value
+    uint32_t expiry_id_;        // Matches this entry's expiration item
+    uint16_t stride_;           // Fisheye stride the OGMs arrive through
+
+    CoreNeighbor() :
+        neighbor_addr_(), curr_seqno_(0), last_valid_seqno_(0),
+        packet_count_(0), last_valid_time_(0), last_ttl_(0), tq_value_(0.0),
+        expiry_id_(0), stride_(1) {}
+
+    void updateWindow(uint16_t seqno) {
+        // Mark sequence number; the bitmap slides itself on advance
+        sliding_window_.mark(seqno);
+
+        // Update packet count, making up for seqnos skipped by fisheye relays
+        packet_count_ = sliding_window_.count() * stride_;
+        if (packet_count_ > WINDOW_SIZE)
+            packet_count_ = WINDOW_SIZE;
+    }
+
+    bool isInWindow(uint16_t seqno) const {
+        return sliding_window_.inRange(seqno);
+    }
+
+    double calculateTQ() {
+        if (packet_count_ == 0)
+            return 0.0;
+
+        // TQ = packets_received / WINDOW_SIZE
+        tq_value_ = (double)packet_count_ / (double)WINDOW_SIZE;
+        return tq_value_;
+    }
+};
+
+/* Originator entry in the routing table */
+template <class Addr>
+class CoreOriginator {
+public:
+    typedef CoreNeighbor<Addr> Neighbor;
+    typedef SmallVector<Neighbor, NEIGHBOR_INLINE> NeighborList;
+
+    Addr orig_addr_;            // Originator address
+    uint16_t curr_seqno_;       // Current sequence number from this originator
+    double last_aware_time_;    // Last time we heard from this originator
+    NeighborList neighbor_info_; // Info per neighbor, stored inline
+    Addr best_next_hop_;        // Best next hop to reach this originator
+    int best_route_count_;      // Packet count of best route
+    uint16_t bidir_link_seqno_; // Sequence number for bidirectional link check
+    std::vector<std::pair<Addr, uint8_t> > hna_list_; // HNA announcements
+
+    // Gateway information
+    bool is_gateway_;
+    uint8_t gw_flags_;
+    uint16_t gw_port_;
+
+    uint32_t expiry_id_;        // Matches this entry's expiration item
+    bool dirty_;                // Route publishing deferred to a batch
+
+    CoreOriginator() :
+        orig_addr_(), curr_seqno_(0), last_aware_time_(0),
+        best_next_hop_(), best_route_count_(0), bidir_link_seqno_(0),
+        is_gateway_(false), gw_flags_(0), gw_port_(0), expiry_id_(0),
+        dirty_(false) {}
+
+    bool hasRoute() const { return best_next_hop_ != Addr(); }
+
+    /* Neighbor pointers are valid until the next add or remove */
+    Neighbor* findNeighborInfo(const Addr &neighbor) {
+        // Linear scan over the inline records
+        for (size_t i = 0; i < neighbor_info_.size(); i++) {
+            if (neighbor_info_[i].neighbor_addr_ == neighbor)
+                return &neighbor_info_[i];
+        }
+        return NULL;
+    }
+
+    Neighbor* getNeighborInfo(const Addr &neighbor) {
+        Neighbor *ni = findNeighborInfo(neighbor);
+        if (ni != NULL)
+            return ni;
+
+        // Create new neighbor info
+        ni = &neighbor_info_.emplace_back();
+        ni->neighbor_addr_ = neighbor;
+        return ni;
+    }
+
+    void removeNeighborInfo(const Addr &neighbor) {
+        for (size_t i = 0; i < neighbor_info_.size(); i++) {
+            if (neighbor_info_[i].neighbor_addr_ == neighbor) {
+                neighbor_info_.swap_remove(i);
+                return;
+            }
+        }
+    }
+
+    /* Rescan all neighbors; true if the route changed */
+    bool updateBestNextHop() {
+        Addr old_best = best_next_hop_;
+        int max_count = 0;
+        Addr best_neighbor = Addr();
+
+        // Find neighbor with highest packet count; ties go to the lowest address
+        for (size_t i = 0; i < neighbor_info_.size(); i++) {
+            Neighbor &ni = neighbor_info_[i];
+            if (ni.packet_count_ > max_count ||
+                (ni.packet_count_ == max_count && max_count > 0 &&
+                 ni.neighbor_addr_ < best_neighbor)) {
+                max_count = ni.packet_count_;
+                best_neighbor = ni.neighbor_addr_;
+            }
+        }
+
+        best_next_hop_ = best_neighbor;
+        best_route_count_ = max_count;
+
+        return old_best != best_next_hop_;
+    }
+
+    /* Account for one neighbor's new count; true if the route changed */
+    bool neighborUpdated(Neighbor *ni) {
+        int count = ni->packet_count_;
+
+        // The best neighbor only forces a rescan when its count drops
+        if (ni->neighbor_addr_ == best_next_hop_) {
+            if (count >= best_route_count_) {
+                best_route_count_ = count;
+                return false;
+            }
+            return updateBestNextHop();
+        }
+
+        // Any other neighbor can only take over by beating the best
+        if (count > best_route_count_ ||
+            (count == best_route_count_ && count > 0 &&
+             ni->neighbor_addr_ < best_next_hop_)) {
+            best_next_hop_ = ni->neighbor_addr_;
+            best_route_count_ = count;
+            return true;
+        }
+        return false;
+    }
+};
+
+/* The fields of a received OGM the core looks at */
+template <class Addr>
+struct CoreOgm {
+    Addr sender_;               // Neighbor the OGM was received from
+    Addr orig_;
+    uint16_t seqno_;
+    uint8_t ttl_;
+    uint8_t flags_;
+    uint8_t gw_flags_;
+    uint16_t gw_port_;
+
+    CoreOgm() :
+        sender_(), orig_(), seqno_(0), ttl_(0), flags_(0), gw_flags_(0),
+        gw_port_(0) {}
+};
+
+/*
+ * Notifications from the core to its simulator adapter. All default to
+ * doing nothing; scheduleRecompute() must arrange a call to
+ * BatmanCore::recompute() after delay seconds if batching is used.
+ */
+template <class Addr>
+class CoreEvents {
+public:
+    virtual ~CoreEvents() {}
+
+    virtual void originatorAdded(const Addr &) {}
+    virtual void originatorRemoved(const Addr &) {}
+    virtual void routeChanged(const Addr & /* dest */,
+                              const Addr & /* old_next_hop */,
+                              const Addr & /* new_next_hop */,
+                              int /* count */) {}
+    virtual void gatewayChanged(const Addr & /* old_gw */,
+                                const Addr & /* new_gw */) {}
+    virtual void topologyChanged() {}
+    virtual void scheduleRecompute(double /* delay */) {}
+};
+
+/* Adapts a FlatIndex policy to the hash functor DuplicateCache expects */
+template <class Addr, class Index>
+struct IndexHash {
+    size_t operator()(const Addr &a) const { return Index::hash(a); }
+};
+
+/*
+ * One node's protocol state. The adapter feeds it received OGMs and
+ * calls purge() every PURGE_INTERVAL; everything else happens inside.
+ * The core never sends: receiveOGM() says whether to rebroadcast and
+ * the adapter does so in its own packet format.
+ */
+template <class Addr, class Clock, class Index = FlatIndex<Addr> >
+class BatmanCore {
+public:
+    typedef CoreNeighbor<Addr> Neighbor;
+    typedef CoreOriginator<Addr> Originator;
+
+    /*
+     * Slots hold the key and a pointer into orig_pool_, not the entry:
+     * an originator with its inline neighbors is several hundred bytes,
+     * so inline entries would spread every probe over many cache lines,
+     * and a grow would move them under the Originator* held by adapters
+     * and by callers across addOriginator().
+     */
+    typedef FlatTable<Addr, Originator*, Index> OriginatorTable;
+    typedef ForwardingTable<Addr, Index> Fib;
+
+    explicit BatmanCore(const Clock &clock = Clock(),
+                        CoreEvents<Addr> *events = NULL) :
+        clock_(clock), events_(events), self_(), ttl_value_(TTL_MAX),
+        originator_interval_(ORIGINATOR_INTERVAL),
+        bi_link_timeout_(BI_LINK_TIMEOUT), purge_timeout_(PURGE_TIMEOUT),
+        expiry_wheel_(PURGE_INTERVAL), next_expiry_id_(0), selected_gw_(),
+        snapshots_enabled_(false), routes_dirty_(false), batch_staleness_(0),
+        topology_changes_(0), bcast_log_(PURGE_TIMEOUT) {
+        if (events_ == NULL)
+            events_ = &no_events_;
+    }
+
+    ~BatmanCore() {
+        // Delete all originator entries
+        typename OriginatorTable::iterator it;
+        for (it = rt_table_.begin(); it != rt_table_.end(); ++it) {
+            orig_pool_.destroy(it->second);
+        }
+        rt_table_.clear();
+    }
+
+    /* ===== Configuration ===== */
+
+    void setEvents(CoreEvents<Addr> *events) {
+        events_ = (events != NULL) ? events : &no_events_;
+    }
+    Clock& clock() { return clock_; }
+
+    void setAddress(const Addr &self) { self_ = self; }
+    const Addr& address() const { return self_; }
+
+    /* Initial TTL, assumed shared by all originators for hop counting */
+    void setTtl(uint8_t ttl) { ttl_value_ = ttl; }
+
+    /* The bidirectional link timeout follows the originator interval */
+    void setOriginatorInterval(double interval) {
+        originator_interval_ = interval;
+        bi_link_timeout_ = BI_LINK_TIMEOUT / ORIGINATOR_INTERVAL * interval;
+    }
+
+    void setPurgeTimeout(double timeout) {
+        purge_timeout_ = timeout;
+        bcast_log_.setTimeout(timeout);
+    }
+
+    /* Node IDs 0..num_nodes-1 index the tables directly */
+    void enableDenseAddressing(size_t num_nodes) {
+        rt_table_.enableDense(num_nodes);
+        fib_.enableDense(num_nodes);
+    }
+
+    /* Hop-scoped relaying; see batman_fisheye.h */
+    FisheyeScope& fisheye() { return fisheye_; }
+
+    /* ===== OGM Reception ===== */
+
+    /*
+     * Process one OGM that passed the adapter's format checks. Returns
+     * OGM_ACCEPTED if it was counted for its originator and OGM_FORWARD
+     * if it should be rebroadcast; 0 means drop it.
+     */
+    int receiveOGM(const CoreOgm<Addr> &ogm) {
+        stats_.ogm_received_++;
+        if (ogm.sender_ == self_)
+            return 0;
+
+        // Our own OGM echoed back - update bidirectional link info
+        if (ogm.orig_ == self_) {
+            if (ogm.flags_ & BATMAN_FLAG_DIRECTLINK)
+                updateBidirLinkSeqno(ogm.sender_, ogm.seqno_);
+            return 0;
+        }
+
+        if (ogm.flags_ & BATMAN_FLAG_UNIDIRECTIONAL) {
+            stats_.ogm_unidirectional_++;
+            return 0;
+        }
+
+        // Duplicate - may still need to forward
+        if (isDuplicate(ogm.orig_, ogm.seqno_)) {
+            stats_.ogm_duplicate_++;
+            return shouldForward(ogm) ? OGM_FORWARD : 0;
+        }
+
+        logBroadcast(ogm.orig_, ogm.seqno_);
+
+        if (!checkBidirectionalLink(ogm)) {
+            stats_.ogm_unidirectional_++;
+            return 0;
+        }
+
+        // Fisheye relays further out only pass every stride-th seqno
+        uint16_t stride = fisheye_.received(hopsTravelled(ogm.ttl_));
+        updateNeighborRanking(ogm.orig_, ogm.sender_, ogm.seqno_, ogm.ttl_,
+                              stride);
+
+        if (ogm.gw_flags_ != 0)
+            updateGateway(ogm.orig_, ogm.gw_flags_, ogm.gw_port_);
+
+        return OGM_ACCEPTED | (shouldForward(ogm) ? OGM_FORWARD : 0);
+    }
+
+    bool isDuplicate(const Addr &orig, uint16_t seqno) const {
+        return bcast_log_.isDuplicate(orig, seqno, clock_.now());
+    }
+
+    void logBroadcast(const Addr &orig, uint16_t seqno) {
+        double now = clock_.now();
+        if (bcast_log_.record(orig, seqno, now)) {
+            scheduleExpiry(EXPIRE_BCAST_LOG, orig, orig, 0,
+                           now + purge_timeout_);
+        }
+    }
+
+    bool checkBidirectionalLink(const CoreOgm<Addr> &ogm) {
+        // Forwarded OGMs count as bidirectional if the forwarder is
+        if (!(ogm.flags_ & BATMAN_FLAG_DIRECTLINK) || ogm.sender_ != ogm.orig_)
+            return true;
+
+        // A direct link needs our own OGM echoed back recently
+        Originator *oe = findOriginator(ogm.orig_);
+        if (oe == NULL)
+            return false;
+
+        if (ogm.seqno_ == oe->bidir_link_seqno_)
+            return true;
+
+        if (clock_.now() - oe->last_aware_time_ > bi_link_timeout_)
+            return false;
+
+        return (seqno_diff(oe->bidir_link_seqno_, ogm.seqno_) <=
+                (bi_link_timeout_ / originator_interval_));
+    }
+
+    void updateBidirLinkSeqno(const Addr &orig, uint16_t seqno) {
+        Originator *oe = findOriginator(orig);
+        if (oe != NULL)
+            oe->bidir_link_seqno_ = seqno;
+    }
+
+    /* Hops travelled by an OGM received with ttl */
+    unsigned hopsTravelled(uint8_t ttl) const {
+        return (ttl < ttl_value_) ? ttl_value_ - ttl : 0;
+    }
+
+    /*
+     * Forward if received from the originator over a direct link, or via
+     * the best link as a new seqno or with the same TTL as the last one.
+     */
+    bool shouldForward(const CoreOgm<Addr> &ogm) {
+        Originator *oe = findOriginator(ogm.orig_);
+        if (oe == NULL)
+            return false;
+
+        if ((ogm.flags_ & BATMAN_FLAG_DIRECTLINK) && ogm.sender_ == ogm.orig_)
+            return true;
+
+        // Distant originators are relayed only every stride-th seqno
+        if (!fisheye_.relay(hopsTravelled(ogm.ttl_), ogm.seqno_))
+            return false;
+
+        if (ogm.sender_ == oe->best_next_hop_) {
+            Neighbor *ni = oe->findNeighborInfo(ogm.sender_);
+            if (ni != NULL &&
+                (!ni->isInWindow(ogm.seqno_) || ogm.ttl_ == ni->last_ttl_))
+                return true;
+        }
+        return false;
+    }
+
+    void updateNeighborRanking(const Addr &orig, const Addr &neighbor,
+                               uint16_t seqno, uint8_t ttl,
+                               uint16_t stride = 1) {
+        double now = clock_.now();
+        Originator *oe = addOriginator(orig);
+        oe->last_aware_time_ = now;
+
+        Neighbor *ni = oe->findNeighborInfo(neighbor);
+        if (ni == NULL) {
+            ni = oe->getNeighborInfo(neighbor);
+            ni->expiry_id_ = ++next_expiry_id_;
+            scheduleExpiry(EXPIRE_NEIGHBOR, orig, neighbor, ni->expiry_id_,
+                           now + purge_timeout_);
+
+            // A new direct neighbor changes the local neighbor set
+            if (neighbor == orig)
+                countTopologyChange();
+        }
+        ni->last_valid_time_ = now;
+        ni->last_ttl_ = ttl;
+        ni->stride_ = stride;
+
+        if (seqno_greater_than(seqno, oe->curr_seqno_) ||
+            (oe->curr_seqno_ == 0 && seqno != 0)) {
+            // New sequence number
+            oe->curr_seqno_ = seqno;
+            ni->curr_seqno_ = seqno;
+            ni->last_valid_seqno_ = seqno;
+            ni->updateWindow(seqno);
+        } else if (ni->isInWindow(seqno)) {
+            // Duplicate within window
+            ni->updateWindow(seqno);
+        } else {
+            return;
+        }
+
+        ni->calculateTQ();
+
+        // In batch mode the ranking, which forwarding reads, stays current
+        // and a known route's new next hop is published once per batch;
+        // the first route to an originator is never held back
+        if (batch_staleness_ > 0 && oe->hasRoute()) {
+            if (oe->neighborUpdated(ni) || oe->is_gateway_)
+                markDirty(oe);
+            return;
+        }
+
+        // Update best next hop from this neighbor's new count
+        Addr old_next_hop = oe->best_next_hop_;
+        if (oe->neighborUpdated(ni)) {
+            updateRoute(oe, old_next_hop);
+            commitRoutes();
+        } else if (oe->is_gateway_) {
+            // Same route, but the gateway metric follows its packet count
+            refreshGateway(oe);
+        }
+    }
+
+    void updateGateway(const Addr &orig, uint8_t gw_flags, uint16_t gw_port) {
+        Originator *oe = addOriginator(orig);
+        oe->is_gateway_ = (gw_flags != 0);
+        oe->gw_flags_ = gw_flags;
+        oe->gw_port_ = gw_port;
+
+        refreshGateway(oe);
+    }
+
+    /* ===== Deferred Route Recomputation ===== */
+
+    /* Publish known routes at most staleness seconds late; 0 disables */
+    void setBatchRecompute(double staleness) {
+        batch_staleness_ = staleness;
+        if (batch_staleness_ <= 0)
+            recompute();
+    }
+
+    void recompute() {
+        for (size_t i = 0; i < dirty_.size(); i++) {
+            // Entries purged or recreated since they were marked are skipped
+            Originator *oe = findOriginator(dirty_[i]);
+            if (oe == NULL || !oe->dirty_)
+                continue;
+            oe->dirty_ = false;
+
+            // The ranking is current; bring the forwarding table up to it
+            const Addr *routed = fib_.route(oe->orig_addr_);
+            Addr old_next_hop = (routed != NULL) ? *routed : Addr();
+            if (old_next_hop != oe->best_next_hop_) {
+                updateRoute(oe, old_next_hop);
+            } else if (oe->is_gateway_) {
+                refreshGateway(oe);
+            }
+        }
+        dirty_.clear();
+        commitRoutes();
+    }
+
+    /* ===== Routing Table ===== */
+
+    Originator* findOriginator(const Addr &dest) {
+        typename OriginatorTable::iterator it = rt_table_.find(dest);
+        if (it != rt_table_.end())
+            return it->second;
+        return NULL;
+    }
+
+    /* Find dest, creating its entry if it is new */
+    Originator* addOriginator(const Addr &dest) {
+        Originator *oe = findOriginator(dest);
+        if (oe != NULL)
+            return oe;
+
+        oe = orig_pool_.create();
+        oe->orig_addr_ = dest;
+        oe->last_aware_time_ = clock_.now();
+        oe->expiry_id_ = ++next_expiry_id_;
+        rt_table_[dest] = oe;
+
+        scheduleExpiry(EXPIRE_ORIGINATOR, dest, dest, oe->expiry_id_,
+                       oe->last_aware_time_ + purge_timeout_);
+
+        events_->originatorAdded(dest);
+        return oe;
+    }
+
+    void removeOriginator(const Addr &dest) {
+        dropOriginator(dest);
+        commitRoutes();
+    }
+
+    OriginatorTable& originators() { return rt_table_; }
+
+    /* ===== HNA ===== */
+
+    void addHNA(const Addr &orig, const Addr &network, uint8_t netmask) {
+        Originator *oe = addOriginator(orig);
+
+        // Add or update HNA entry; a changed netmask replaces the old one
+        std::pair<Addr, uint8_t> hna_entry(network, netmask);
+        bool found = false;
+        for (size_t i = 0; i < oe->hna_list_.size(); i++) {
+            if (oe->hna_list_[i].first == network) {
+                fib_.removePrefix(network, oe->hna_list_[i].second, orig);
+                oe->hna_list_[i] = hna_entry;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            oe->hna_list_.push_back(hna_entry);
+        fib_.addPrefix(network, netmask, orig);
+        routes_dirty_ = true;
+        commitRoutes();
+    }
+
+    void removeHNA(const Addr &orig) {
+        Originator *oe = findOriginator(orig);
+        if (oe == NULL)
+            return;
+        withdrawHNA(oe, orig);
+        commitRoutes();
+    }
+
+    /* ===== Route Lookup ===== */
+
+    /* Data-path view of the best routes, kept in step by updateRoute */
+    Fib& fib() { return fib_; }
+    const Fib& fib() const { return fib_; }
+
+    /* Next hop towards dest, originators first, then HNA prefixes */
+    Addr lookup(const Addr &dest) const {
+        Addr next_hop;
+        if (fib_.lookup(dest, next_hop))
+            return next_hop;
+        return Addr();
+    }
+
+    bool hasRoute(const Addr &dest) const {
+        return lookup(dest) != Addr();
+    }
+
+    /* Longest matching announced prefix, via its originator's route */
+    Addr lookupHNA(const Addr &dest) const {
+        Addr next_hop;
+        if (fib_.lookupPrefix(dest, next_hop))
+            return next_hop;
+        return Addr();
+    }
+
+    /* Maintained by refreshGateway as gateway metrics change */
+    Addr selectBestGateway() const { return selected_gw_; }
+
+    /* Concurrent route lookup from other threads, through snapshots */
+    void enableSnapshots() {
+        snapshots_enabled_ = true;
+        snapshots_.publish(fib_);
+        routes_dirty_ = false;
+    }
+    int registerReader() { return snapshots_.registerReader(); }
+    void unregisterReader(int reader) { snapshots_.unregisterReader(reader); }
+
+    /* Safe from any thread holding a reader slot; never touches fib_ */
+    Addr lookupConcurrent(int reader, const Addr &dest) {
+        Addr next_hop;
+        if (snapshots_.lookup(reader, dest, next_hop))
+            return next_hop;
+        return Addr();
+    }
+    uint64_t routeVersion() const { return snapshots_.version(); }
+
+    /* ===== Table Maintenance ===== */
+
+    void scheduleExpiry(ExpiryKind kind, const Addr &orig,
+                        const Addr &neighbor, uint32_t id, double when) {
+        expiry_wheel_.schedule(ExpiryItem<Addr>(kind, orig, neighbor, id),
+                               when);
+    }
+
+    /* Expire what came due; only those entries are looked at */
+    void purge() {
+        double now = clock_.now();
+        std::vector<ExpiryItem<Addr> > due;
+        expiry_wheel_.advance(now, due);
+
+        for (size_t i = 0; i < due.size(); i++) {
+            expireEntry(due[i], now);
+        }
+        commitRoutes();
+    }
+
+    /* ===== Statistics ===== */
+
+    size_t size() const { return rt_table_.size(); }
+
+    /* Counters; adapters add their sending and data path counts */
+    BatmanStats& stats() { return stats_; }
+    const BatmanStats& stats() const { return stats_; }
+
+    /* Local changes: direct neighbors appearing, expiring or re-routed */
+    uint32_t topologyChanges() const { return topology_changes_; }
+    size_t bytesInUse() const { return orig_pool_.bytesInUse(); }
+    size_t bytesReserved() const { return orig_pool_.bytesReserved(); }
+
+protected:
+    Clock clock_;
+    CoreEvents<Addr> *events_;
+    CoreEvents<Addr> no_events_;
+
+    Addr self_;
+    uint8_t ttl_value_;
+    double originator_interval_;
+    double bi_link_timeout_;
+    double purge_timeout_;
+
+    OriginatorTable rt_table_;
+    Fib fib_;
+
+    /* Per-node storage for routing state (neighbors live inline) */
+    ObjectPool<Originator> orig_pool_;
+
+    /* Pending originator, neighbor and broadcast log expirations */
+    TimerWheel<ExpiryItem<Addr> > expiry_wheel_;
+    uint32_t next_expiry_id_;
+
+    /* Gateway ranking and the current selection */
+    GatewayIndex<Addr> gw_index_;
+    Addr selected_gw_;
+
+    /* Lock-free copies of fib_ for data-plane threads, if enabled */
+    RouteSnapshots<Addr, Index> snapshots_;
+    bool snapshots_enabled_;
+    bool routes_dirty_;         // fib_ changed since the last publish
+
+    /* Originators whose route awaits publishing, at most batch_staleness_ old */
+    std::vector<Addr> dirty_;
+    double batch_staleness_;    // 0 recomputes on every OGM
+
+    /* Neighbor set or best route changes, for the adaptive OGM interval */
+    uint32_t topology_changes_;
+    BatmanStats stats_;
+
+    /* Broadcast log (seqnos seen per originator) */
+    DuplicateCache<Addr, double, IndexHash<Addr, Index> > bcast_log_;
+
+    /* Hop-scoped relaying of distant originators' OGMs */
+    FisheyeScope fisheye_;
+
+    /* Withdraw orig's prefixes one by one; other announcers keep theirs */
+    void withdrawHNA(Originator *oe, const Addr &orig) {
+        if (oe->hna_list_.empty())
+            return;
+        for (size_t i = 0; i < oe->hna_list_.size(); i++) {
+            fib_.removePrefix(oe->hna_list_[i].first,
+                              oe->hna_list_[i].second, orig);
+        }
+        oe->hna_list_.clear();
+        routes_dirty_ = true;
+    }
+
+    void dropOriginator(const Addr &dest) {
+        typename OriginatorTable::iterator it = rt_table_.find(dest);
+        if (it == rt_table_.end())
+            return;
+
+        Originator *oe = it->second;
+        withdrawHNA(oe, dest);
+
+        // Losing the originator withdraws its route
+        Addr old_next_hop = oe->best_next_hop_;
+        if (oe->hasRoute()) {
+            oe->best_next_hop_ = Addr();
+            oe->best_route_count_ = 0;
+            updateRoute(oe, old_next_hop);
+        }
+
+        if (gw_index_.remove(dest))
+            reselectGateway();
+
+        orig_pool_.destroy(oe);
+        rt_table_.erase(it);
+        events_->originatorRemoved(dest);
+    }
+
+    void expireEntry(const ExpiryItem<Addr> &item, double now) {
+        if (item.kind_ == EXPIRE_BCAST_LOG) {
+            expireBroadcastLog(item.orig_, now);
+            return;
+        }
+
+        Originator *oe = findOriginator(item.orig_);
+        if (oe == NULL)
+            return;
+
+        if (item.kind_ == EXPIRE_ORIGINATOR) {
+            if (oe->expiry_id_ != item.id_)
+                return;
+
+            // Check if originator is still valid
+            if ((now - oe->last_aware_time_) > purge_timeout_) {
+                dropOriginator(item.orig_);
+            } else {
+                scheduleExpiry(EXPIRE_ORIGINATOR, item.orig_, item.orig_,
+                               item.id_, oe->last_aware_time_ + purge_timeout_);
+            }
+            return;
+        }
+
+        Neighbor *ni = oe->findNeighborInfo(item.neighbor_);
+        if (ni == NULL || ni->expiry_id_ != item.id_)
+            return;
+
+        if ((now - ni->last_valid_time_) > purge_timeout_) {
+            // Only losing the best neighbor can change the route
+            bool was_best = (oe->best_next_hop_ == item.neighbor_);
+            oe->removeNeighborInfo(item.neighbor_);
+            if (item.neighbor_ == item.orig_)
+                countTopologyChange();
+            if (was_best && oe->updateBestNextHop())
+                updateRoute(oe, item.neighbor_);
+        } else {
+            scheduleExpiry(EXPIRE_NEIGHBOR, item.orig_, item.neighbor_,
+                           item.id_, ni->last_valid_time_ + purge_timeout_);
+        }
+    }
+
+    void expireBroadcastLog(const Addr &orig, double now) {
+        if (bcast_log_.expire(orig, now))
+            return;
+
+        // Still in use - check again once its timeout has run out
+        double when;
+        if (bcast_log_.deadline(orig, when))
+            scheduleExpiry(EXPIRE_BCAST_LOG, orig, orig, 0, when);
+    }
+
+    void markDirty(Originator *oe) {
+        if (oe->dirty_)
+            return;
+
+        // The first dirty originator of a batch starts the staleness clock
+        if (dirty_.empty())
+            events_->scheduleRecompute(batch_staleness_);
+        oe->dirty_ = true;
+        dirty_.push_back(oe->orig_addr_);
+    }
+
+    /* Raised whenever an originator's best hop moves */
+    void updateRoute(Originator *oe, const Addr &old_next_hop) {
+        // Keep the data path's forwarding table in step
+        if (oe->hasRoute())
+            fib_.setRoute(oe->orig_addr_, oe->best_next_hop_);
+        else
+            fib_.removeRoute(oe->orig_addr_);
+        routes_dirty_ = true;
+
+        if (oe->is_gateway_)
+            refreshGateway(oe);
+
+        stats_.route_changes_++;
+
+        // Only a direct neighbor gaining or losing its one-hop route
+        // counts; distant routes flap too often in a static mesh to hold
+        // the OGM interval back
+        if (oe->best_next_hop_ == oe->orig_addr_ ||
+            old_next_hop == oe->orig_addr_)
+            countTopologyChange();
+        events_->routeChanged(oe->orig_addr_, old_next_hop,
+                              oe->best_next_hop_, oe->best_route_count_);
+    }
+
+    /* One snapshot per batch of changes, not per changed route */
+    void commitRoutes() {
+        if (!snapshots_enabled_)
+            return;
+        if (routes_dirty_) {
+            snapshots_.publish(fib_);
+            routes_dirty_ = false;
+        } else {
+            snapshots_.reclaim();
+        }
+    }
+
+    void refreshGateway(Originator *oe) {
+        int metric = 0;
+        if (oe->is_gateway_ && oe->hasRoute()) {
+            // Simple metric: packet count * gateway class
+            metric = oe->best_route_count_ * (int)oe->gw_flags_;
+        }
+
+        if (gw_index_.update(oe->orig_addr_, metric))
+            reselectGateway();
+    }
+
+    void reselectGateway() {
+        Addr old_gw = selected_gw_;
+        if (!gw_index_.best(selected_gw_))
+            selected_gw_ = Addr();
+
+        events_->gatewayChanged(old_gw, selected_gw_);
+    }
+
+    void countTopologyChange() {
+        topology_changes_++;
+        events_->topologyChanged();
+    }
+
+private:
+    BatmanCore(const BatmanCore&);
+    BatmanCore& operator=(const BatmanCore&);
+};
+
+#endif /* __batman_core_h__ */
@@ -0,0 +1,103 @@
+/*
+ * batman_dupcache.h
+ * B.A.T.M.A.N. Broadcast Duplicate Detection
+ *
+ * Per-originator record of the sequence numbers already seen, replacing
+ * the linear broadcast log. Templated on address and time type so the
+ * NS2 agent (nsaddr_t, double) and the NS3 protocol (Ipv4Address, Time)
+ * share one implementation.
+ */
+
+#ifndef __batman_dupcache_h__
+#define __batman_dupcache_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <utility>
+#include <unordered_map>
+
+#include "batman_window.h"
+
+/*
+ * Each originator owns a SeqnoWindow of the seqnos we have logged plus
+ * the time of the last one. Lookup, insert and expiry are all a single
+ * hash probe. Seqnos older than the window are reported as duplicates:
+ * they have been superseded and must not be processed as new OGMs.
+ */
+template <class Addr, class TimeT, class Hash = std::hash<Addr> >
+class DuplicateCache {
+public:
+    explicit DuplicateCache(TimeT timeout = TimeT()) : timeout_(timeout) {}
+
+    void setTimeout(TimeT timeout) { timeout_ = timeout; }
+
+    /* Has (orig, seqno) already been logged? */
+    bool isDuplicate(const Addr &orig, uint16_t seqno, TimeT now) const {
+        typename Table::const_iterator it = entries_.find(orig);
+        if (it == entries_.end() || expired(it->second, now))
+            return false;
+
+        const SeqnoWindow &seen = it->second.seen_;
+        if (seen.inRange(seqno))
+            return seen.isSet(seqno);
+
+        // Outside the window: only a newer seqno is unseen
+        uint16_t ahead = (uint16_t)(seqno - seen.newest());
+        return !(ahead != 0 && ahead < 0x8000);
+    }
+
+    /* Log (orig, seqno) as seen at time now; true if orig was not tracked */
+    bool record(const Addr &orig, uint16_t seqno, TimeT now) {
+        // Look up first: insert() builds a node even for a known key
+        typename Table::iterator it = entries_.find(orig);
+        bool added = (it == entries_.end());
+        if (added)
+            it = entries_.insert(std::make_pair(orig, Entry())).first;
+        Entry &e = it->second;
+        if (expired(e, now))
+            e.seen_.reset();
+        e.seen_.mark(seqno);
+        e.last_time_ = now;
+        return added;
+    }
+
+    /* Drop the originator's log if nothing was recorded within timeout */
+    bool expire(const Addr &orig, TimeT now) {
+        typename Table::iterator it = entries_.find(orig);
+        if (it == entries_.end() || !expired(it->second, now))
+            return false;
+        entries_.erase(it);
+        return true;
+    }
+
+    /* Time after which the originator's log lapses */
+    bool deadline(const Addr &orig, TimeT &when) const {
+        typename Table::const_iterator it = entries_.find(orig);
+        if (it == entries_.end())
+            return false;
+        when = it->second.last_time_ + timeout_;
+        return true;
+    }
+
+    void clear() { entries_.clear(); }
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        SeqnoWindow seen_;   // Seqnos logged for this originator
+        TimeT last_time_;    // Time of the last logged seqno
+
+        Entry() : last_time_() {}
+    };
+    typedef std::unordered_map<Addr, Entry, Hash> Table;
+
+    Table entries_;
+    TimeT timeout_;
+
+    bool expired(const Entry &e, TimeT now) const {
+        return e.seen_.empty() || (now - e.last_time_) > timeout_;
+    }
+};
+
+#endif /* __batman_dupcache_h__ */
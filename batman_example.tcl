@@ -112,6 +112,9 @@ for {set i 0} {$i < $val(nn)} {incr i} {
     # Set TTL
     $batman_agent ttl 64
     
+    # Node IDs are 0..nn-1: index the originator table directly
+    $batman_agent dense-addressing $val(nn)
+    
     # Configure node 0 as gateway
     if {$i == 0} {
         $batman_agent gateway 128 5000  ;# gateway class=128, port=5000
@@ -176,6 +179,11 @@ proc print_rtable {} {
 # Schedule first routing table print
 $ns at 30.0 "print_rtable"
 
+# Latency histograms of the OGM and data paths, dumped by finish
+for {set i 0} {$i < $val(nn)} {incr i} {
+    [$node_($i) set ragent_] latency-histograms
+}
+
 # ======================================================================
 # Tell nodes when the simulation ends
 # ======================================================================
@@ -187,11 +195,17 @@ for {set i 0} {$i < $val(nn)} {incr i} {
 # Finish procedure
 # ======================================================================
 proc finish {} {
-    global ns tracefd namtrace
+    global ns tracefd namtrace node_ val
     $ns flush-trace
     close $tracefd
     close $namtrace
     
+    puts "\nPer-node counters:"
+    for {set i 0} {$i < $val(nn)} {incr i} {
+        puts "Node $i: [[$node_($i) set ragent_] stats]"
+    }
+    [$node_(0) set ragent_] latency-dump all
+    
     puts "\nSimulation finished!"
     puts "Trace file: batman_trace.tr"
     puts "NAM file: batman_nam.nam"
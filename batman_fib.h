@@ -0,0 +1,93 @@
+/*
+ * batman_fib.h
+ * B.A.T.M.A.N. Forwarding Table
+ *
+ * Compact destination -> next hop table read by the data path. The
+ * routing table writes it only when a best next hop changes, so data
+ * forwarding never touches originator or sliding-window state.
+ */
+
+#ifndef __batman_fib_h__
+#define __batman_fib_h__
+
+#include <stdint.h>
+
+#include "batman_flat_table.h"
+#include "batman_lpm.h"
+
+/*
+ * Host routes map a destination to its next hop. HNA prefix routes map a
+ * network to the originator announcing it in a longest-prefix-match trie
+ * and resolve through that originator's host route, so a route change
+ * never has to revisit the prefixes. Index::bits() gives the address as
+ * a 32-bit integer.
+ */
+template <class Addr, class Index = FlatIndex<Addr> >
+class ForwardingTable {
+public:
+    /* Index node IDs below n directly */
+    void enableDense(size_t n) { routes_.enableDense(n); }
+
+    /* Install or replace the host route to dest */
+    void setRoute(const Addr &dest, const Addr &next_hop) {
+        routes_[dest] = next_hop;
+    }
+
+    void removeRoute(const Addr &dest) { routes_.erase(dest); }
+
+    /* Host route to dest only, NULL if none */
+    const Addr* route(const Addr &dest) const { return routes_.get(dest); }
+
+    /* Announce network/prefix_len as reachable through orig */
+    void addPrefix(const Addr &network, uint8_t prefix_len, const Addr &orig) {
+        prefixes_.insert(Index::bits(network), prefix_len, orig);
+    }
+
+    /* Withdraw orig's announcement of network/prefix_len */
+    void removePrefix(const Addr &network, uint8_t prefix_len,
+                      const Addr &orig) {
+        prefixes_.remove(Index::bits(network), prefix_len, orig);
+    }
+
+    /* Next hop towards dest: host route first, then longest prefix */
+    bool lookup(const Addr &dest, Addr &next_hop) const {
+        const Addr *hop = routes_.get(dest);
+        if (hop != NULL) {
+            next_hop = *hop;
+            return true;
+        }
+        return lookupPrefix(dest, next_hop);
+    }
+
+    /*
+     * Next hop towards dest through the longest matching HNA prefix, via
+     * the first of its announcers we have a route to
+     */
+    bool lookupPrefix(const Addr &dest, Addr &next_hop) const {
+        const typename Prefixes::Announcers *origs =
+            prefixes_.lookup(Index::bits(dest));
+        if (origs == NULL)
+            return false;
+
+        for (size_t i = 0; i < origs->size(); i++) {
+            const Addr *hop = routes_.get((*origs)[i]);
+            if (hop != NULL) {
+                next_hop = *hop;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t routes() const { return routes_.size(); }
+    size_t prefixes() const { return prefixes_.size(); }
+
+private:
+    typedef FlatTable<Addr, Addr, Index> Routes;
+    typedef PrefixTrie<Addr> Prefixes;
+
+    Routes routes_;
+    Prefixes prefixes_;           // Network -> announcing originators
+};
+
+#endif /* __batman_fib_h__ */
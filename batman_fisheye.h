@@ -0,0 +1,63 @@
+/*
+ * batman_fisheye.h
+ * B.A.T.M.A.N. Fisheye Rebroadcast Scope
+ *
+ * Hop-scoped OGM relaying: OGMs are relayed at full rate near their
+ * originator and only every k-th sequence number further away, so
+ * control traffic stops growing with the square of the mesh size.
+ */
+
+#ifndef __batman_fisheye_h__
+#define __batman_fisheye_h__
+
+#include <stdint.h>
+
+/*
+ * An OGM that has travelled hops hops (initial TTL minus current TTL) is
+ * relayed only if its seqno is a multiple of stride(hops). The stride is
+ * 1 within radius hops and doubles every further radius hops, up to
+ * max_stride. Strides are powers of two, so every relay on a path picks
+ * a subset of what the previous one relayed and seqno wraparound keeps
+ * the pattern. Receivers scale their window counts by the stride the
+ * OGM came through, so distant routes are not penalised for the skips.
+ */
+class FisheyeScope {
+public:
+    FisheyeScope() : radius_(0), max_stride_(1) {}
+
+    /* radius 0 turns fisheye relaying off */
+    void configure(unsigned radius, unsigned max_stride) {
+        radius_ = radius;
+        max_stride_ = 1;
+        while (max_stride_ * 2 <= max_stride && max_stride_ < 0x8000)
+            max_stride_ *= 2;
+    }
+
+    bool enabled() const { return radius_ > 0; }
+
+    /* Relay stride for an OGM received after hops hops */
+    unsigned stride(unsigned hops) const {
+        if (!enabled())
+            return 1;
+        unsigned k = 1;
+        for (unsigned h = radius_; h <= hops && k < max_stride_; h += radius_)
+            k *= 2;
+        return k;
+    }
+
+    /* Whether to relay seqno after hops hops */
+    bool relay(unsigned hops, uint16_t seqno) const {
+        return (seqno & (stride(hops) - 1)) == 0;
+    }
+
+    /* Stride already applied to an OGM received after hops hops */
+    unsigned received(unsigned hops) const {
+        return hops == 0 ? 1 : stride(hops - 1);
+    }
+
+private:
+    unsigned radius_;       // Hops relayed at full rate
+    unsigned max_stride_;   // Power of two
+};
+
+#endif /* __batman_fisheye_h__ */
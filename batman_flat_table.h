@@ -0,0 +1,229 @@
+/*
+ * batman_flat_table.h
+ * B.A.T.M.A.N. Open-Addressing Hash Table
+ *
+ * Cache-friendly replacement for the std::map originator tables. Key and
+ * value live inline in one slot array probed linearly, and an optional
+ * dense region indexes small keys (simulator node IDs 0..N-1) directly.
+ */
+
+#ifndef __batman_flat_table_h__
+#define __batman_flat_table_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+/*
+ * Hashing policy. hash() spreads keys over the probe table, index()
+ * maps a key to its dense slot; keys whose index is beyond the dense
+ * region fall back to hashing. bits() is the key as a 32-bit address
+ * for prefix matching. The default handles integral addresses such as
+ * nsaddr_t.
+ */
+template <class Key>
+struct FlatIndex {
+    static uint32_t hash(const Key &k) {
+        uint32_t h = (uint32_t)k * 2654435769u;
+        return h ^ (h >> 16);
+    }
+    static size_t index(const Key &k) { return (uint32_t)k; }
+    static uint32_t bits(const Key &k) { return (uint32_t)k; }
+};
+
+template <class Key, class Value, class Index = FlatIndex<Key> >
+class FlatTable {
+public:
+    typedef std::pair<Key, Value> value_type;
+
+    class iterator {
+    public:
+        iterator() : table_(NULL), pos_(0) {}
+        value_type& operator*() const { return table_->slotAt(pos_); }
+        value_type* operator->() const { return &table_->slotAt(pos_); }
+        iterator& operator++() { pos_ = table_->nextFull(pos_ + 1); return *this; }
+        iterator operator++(int) { iterator old = *this; ++(*this); return old; }
+        bool operator==(const iterator &o) const { return pos_ == o.pos_; }
+        bool operator!=(const iterator &o) const { return pos_ != o.pos_; }
+    private:
+        friend class FlatTable;
+        iterator(FlatTable *table, size_t pos) : table_(table), pos_(pos) {}
+        FlatTable *table_;
+        size_t pos_;   // Dense slots first, then probe slots
+    };
+
+    FlatTable() : size_(0), used_(0) {}
+
+    /* Index keys below n directly instead of hashing them */
+    void enableDense(size_t n) {
+        std::vector<value_type> old;
+        collect(old);
+        dense_.assign(n, value_type());
+        dense_state_.assign(n, EMPTY);
+        slots_.clear();
+        state_.clear();
+        size_ = 0;
+        used_ = 0;
+        for (size_t i = 0; i < old.size(); i++)
+            insert(old[i].first, old[i].second);
+    }
+
+    size_t denseSize() const { return dense_.size(); }
+
+    iterator begin() { return iterator(this, nextFull(0)); }
+    iterator end() { return iterator(this, dense_.size() + slots_.size()); }
+
+    iterator find(const Key &k) {
+        size_t d = Index::index(k);
+        if (d < dense_.size())
+            return dense_state_[d] == FULL ? iterator(this, d) : end();
+
+        if (slots_.empty())
+            return end();
+        size_t mask = slots_.size() - 1;
+        for (size_t i = Index::hash(k) & mask; ; i = (i + 1) & mask) {
+            if (state_[i] == EMPTY)
+                return end();
+            if (state_[i] == FULL && slots_[i].first == k)
+                return iterator(this, dense_.size() + i);
+        }
+    }
+
+    /* Value stored for k, or NULL; does not modify the table */
+    const Value* get(const Key &k) const {
+        size_t d = Index::index(k);
+        if (d < dense_.size())
+            return dense_state_[d] == FULL ? &dense_[d].second : NULL;
+
+        if (slots_.empty())
+            return NULL;
+        size_t mask = slots_.size() - 1;
+        for (size_t i = Index::hash(k) & mask; ; i = (i + 1) & mask) {
+            if (state_[i] == EMPTY)
+                return NULL;
+            if (state_[i] == FULL && slots_[i].first == k)
+                return &slots_[i].second;
+        }
+    }
+
+    /* Insert (k, v) unless k is present; may invalidate iterators */
+    std::pair<iterator, bool> insert(const Key &k, const Value &v) {
+        iterator it = find(k);
+        if (it != end())
+            return std::make_pair(it, false);
+
+        size_t d = Index::index(k);
+        if (d < dense_.size()) {
+            dense_[d] = value_type(k, v);
+            dense_state_[d] = FULL;
+            size_++;
+            return std::make_pair(iterator(this, d), true);
+        }
+
+        if ((used_ + 1) * 4 > slots_.size() * 3)
+            rehash();
+
+        size_t mask = slots_.size() - 1;
+        size_t i = Index::hash(k) & mask;
+        while (state_[i] == FULL)
+            i = (i + 1) & mask;
+        if (state_[i] == EMPTY)
+            used_++;
+        slots_[i] = value_type(k, v);
+        state_[i] = FULL;
+        size_++;
+        return std::make_pair(iterator(this, dense_.size() + i), true);
+    }
+
+    Value& operator[](const Key &k) {
+        return insert(k, Value()).first->second;
+    }
+
+    /* Erase the entry at it; other iterators stay valid */
+    iterator erase(iterator it) {
+        if (it.pos_ < dense_.size()) {
+            dense_state_[it.pos_] = EMPTY;
+        } else {
+            state_[it.pos_ - dense_.size()] = DELETED;
+        }
+        size_--;
+        return iterator(this, nextFull(it.pos_ + 1));
+    }
+
+    size_t erase(const Key &k) {
+        iterator it = find(k);
+        if (it == end())
+            return 0;
+        erase(it);
+        return 1;
+    }
+
+    void clear() {
+        dense_state_.assign(dense_.size(), EMPTY);
+        slots_.clear();
+        state_.clear();
+        size_ = 0;
+        used_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    enum { EMPTY = 0, FULL = 1, DELETED = 2 };
+
+    std::vector<value_type> dense_;    // Directly indexed slots
+    std::vector<uint8_t> dense_state_;
+    std::vector<value_type> slots_;    // Linear probing, power of two
+    std::vector<uint8_t> state_;
+    size_t size_;                      // Live entries
+    size_t used_;                      // Probe slots FULL or DELETED
+
+    value_type& slotAt(size_t pos) {
+        return pos < dense_.size() ? dense_[pos] : slots_[pos - dense_.size()];
+    }
+
+    size_t nextFull(size_t pos) const {
+        size_t nd = dense_.size();
+        for (; pos < nd; pos++)
+            if (dense_state_[pos] == FULL)
+                return pos;
+        for (; pos < nd + slots_.size(); pos++)
+            if (state_[pos - nd] == FULL)
+                return pos;
+        return pos;
+    }
+
+    void collect(std::vector<value_type> &out) {
+        for (iterator it = begin(); it != end(); ++it)
+            out.push_back(*it);
+    }
+
+    /* Rebuild the probe table at most half full, dropping tombstones */
+    void rehash() {
+        size_t capacity = 16;
+        while ((size_ + 1) * 2 > capacity)
+            capacity *= 2;
+
+        std::vector<value_type> old_slots(capacity);
+        std::vector<uint8_t> old_state(capacity, EMPTY);
+        old_slots.swap(slots_);
+        old_state.swap(state_);
+
+        size_t mask = capacity - 1;
+        used_ = 0;
+        for (size_t j = 0; j < old_slots.size(); j++) {
+            if (old_state[j] != FULL)
+                continue;
+            size_t i = Index::hash(old_slots[j].first) & mask;
+            while (state_[i] == FULL)
+                i = (i + 1) & mask;
+            slots_[i] = old_slots[j];
+            state_[i] = FULL;
+            used_++;
+        }
+    }
+};
+
+#endif /* __batman_flat_table_h__ */
@@ -0,0 +1,75 @@
+/*
+ * batman_gateway.h
+ * B.A.T.M.A.N. Gateway Index
+ *
+ * Gateways ranked by metric, kept up to date as their routes change so
+ * the best one is available in O(1) instead of by a table scan.
+ */
+
+#ifndef __batman_gateway_h__
+#define __batman_gateway_h__
+
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <utility>
+
+/*
+ * Ranking is by metric (best route count * gateway class), highest
+ * first, with ties going to the lowest address. A gateway with a metric
+ * of zero or less is not selectable and is dropped from the ranking.
+ */
+template <class Addr>
+class GatewayIndex {
+public:
+    GatewayIndex() : best_(), has_best_(false) {}
+
+    /* Set gw's metric; true if the selected gateway changed */
+    bool update(const Addr &gw, int metric) {
+        typename Metrics::iterator it = metrics_.find(gw);
+        if (it != metrics_.end()) {
+            if (it->second == metric)
+                return false;
+            ranked_.erase(Rank(-it->second, gw));
+            metrics_.erase(it);
+        }
+        if (metric > 0) {
+            metrics_[gw] = metric;
+            ranked_.insert(Rank(-metric, gw));
+        }
+        return reselect();
+    }
+
+    /* Forget gw; true if the selected gateway changed */
+    bool remove(const Addr &gw) { return update(gw, 0); }
+
+    /* Currently selected gateway, if any */
+    bool best(Addr &gw) const {
+        if (!has_best_)
+            return false;
+        gw = best_;
+        return true;
+    }
+
+    size_t size() const { return metrics_.size(); }
+
+private:
+    typedef std::pair<int, Addr> Rank;   // (-metric, address)
+    typedef std::map<Addr, int> Metrics;
+
+    Metrics metrics_;
+    std::set<Rank> ranked_;   // Best gateway first
+    Addr best_;
+    bool has_best_;
+
+    bool reselect() {
+        bool had_best = has_best_;
+        Addr old_best = best_;
+        has_best_ = !ranked_.empty();
+        if (has_best_)
+            best_ = ranked_.begin()->second;
+        return had_best != has_best_ || (has_best_ && !(best_ == old_best));
+    }
+};
+
+#endif /* __batman_gateway_h__ */
@@ -0,0 +1,216 @@
+/*
+ * batman_histogram.h
+ * B.A.T.M.A.N. Latency Histograms
+ *
+ * Log-bucketed histograms, after HdrHistogram, of how long the OGM and
+ * data paths take. Recording is a bucket increment, histograms of the
+ * same shape add bucket by bucket, so every agent keeps its own and
+ * they are merged when the run ends.
+ */
+
+#ifndef __batman_histogram_h__
+#define __batman_histogram_h__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+/* Sub-buckets per power of two: 2^4 keeps values within 1/16 */
+#define LATENCY_SUB_BITS 4
+
+/* Values up to 2^40 ns (about 18 minutes); larger ones are clamped */
+#define LATENCY_MAX_BITS 40
+
+/*
+ * Values below 2 * 2^LATENCY_SUB_BITS get a bucket each. Above that every
+ * power of two [2^k, 2^(k+1)) is split into 2^LATENCY_SUB_BITS equal
+ * buckets, so the bucket width grows with the value and the relative
+ * error stays bounded across the whole range in a few hundred buckets.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() :
+        buckets_((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) <<
+                 LATENCY_SUB_BITS) {
+        reset();
+    }
+
+    void reset() {
+        buckets_.assign(buckets_.size(), 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    void record(uint64_t value) {
+        if (value >> LATENCY_MAX_BITS)
+            value = (1ULL << LATENCY_MAX_BITS) - 1;
+        buckets_[index(value)]++;
+        count_++;
+        sum_ += value;
+        if (value < min_)
+            min_ = value;
+        if (value > max_)
+            max_ = value;
+    }
+
+    void merge(const LatencyHistogram &o) {
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            buckets_[i] += o.buckets_[i];
+        }
+        count_ += o.count_;
+        sum_ += o.sum_;
+        if (o.min_ < min_)
+            min_ = o.min_;
+        if (o.max_ > max_)
+            max_ = o.max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? (double)sum_ / count_ : 0; }
+
+    /* Upper end of the bucket holding the q-quantile, capped at max() */
+    uint64_t percentile(double q) const {
+        if (count_ == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(q * count_);
+        if (rank >= count_)
+            rank = count_ - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            seen += buckets_[i];
+            if (seen > rank)
+                return highest(i) < max_ ? highest(i) : max_;
+        }
+        return max_;
+    }
+
+    /* One line: count, mean, p50 .. p99.99 and max, no newline */
+    void format(char *buf, size_t len, const char *name,
+                const char *unit) const {
+        snprintf(buf, len, "%s count %llu mean %.0f p50 %llu p90 %llu "
+                 "p99 %llu p99.9 %llu p99.99 %llu max %llu %s", name,
+                 (unsigned long long)count_, mean(),
+                 (unsigned long long)percentile(0.5),
+                 (unsigned long long)percentile(0.9),
+                 (unsigned long long)percentile(0.99),
+                 (unsigned long long)percentile(0.999),
+                 (unsigned long long)percentile(0.9999),
+                 (unsigned long long)max(), unit);
+    }
+
+private:
+    std::vector<uint64_t> buckets_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+
+    static size_t index(uint64_t value) {
+        if (value < (2ULL << LATENCY_SUB_BITS))
+            return (size_t)value;
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned shift = msb - LATENCY_SUB_BITS;
+        return ((size_t)(shift + 1) << LATENCY_SUB_BITS) +
+               (size_t)((value >> shift) - (1ULL << LATENCY_SUB_BITS));
+    }
+
+    /* Largest value that lands in bucket i */
+    static uint64_t highest(size_t i) {
+        if (i < (2U << LATENCY_SUB_BITS))
+            return i;
+        unsigned shift = (unsigned)(i >> LATENCY_SUB_BITS) - 1;
+        uint64_t m = (i & ((1U << LATENCY_SUB_BITS) - 1)) +
+                     (1ULL << LATENCY_SUB_BITS);
+        return ((m + 1) << shift) - 1;
+    }
+};
+
+/* What an agent's histograms measure */
+enum LatencyPath {
+    LATENCY_RECV_OGM,       // Receiving one OGM (wall clock)
+    LATENCY_RECV_DATA,      // Routing one data packet (wall clock)
+    LATENCY_PURGE,          // One routing table purge (wall clock)
+    LATENCY_FORWARD_DELAY,  // Delay before a rebroadcast leaves (sim time)
+    LATENCY_PATHS
+};
+
+/* One agent's histograms, in nanoseconds */
+class BatmanLatency {
+public:
+    LatencyHistogram& operator[](LatencyPath path) { return hist_[path]; }
+
+    void reset() {
+        for (int i = 0; i < LATENCY_PATHS; i++) {
+            hist_[i].reset();
+        }
+    }
+
+    void merge(const BatmanLatency &o) {
+        for (int i = 0; i < LATENCY_PATHS; i++) {
+            hist_[i].merge(o.hist_[i]);
+        }
+    }
+
+    const LatencyHistogram& get(LatencyPath path) const {
+        return hist_[path];
+    }
+
+    static const char* name(LatencyPath path) {
+        static const char *names[LATENCY_PATHS] = {
+            "recv_ogm", "recv_data", "purge", "forward_delay"
+        };
+        return names[path];
+    }
+
+    /* One line per histogram, each name preceded by prefix */
+    void print(FILE *out, const char *prefix) const {
+        char name[96];
+        char line[256];
+        for (int i = 0; i < LATENCY_PATHS; i++) {
+            snprintf(name, sizeof(name), "%s%s", prefix,
+                     BatmanLatency::name((LatencyPath)i));
+            hist_[i].format(line, sizeof(line), name, "ns");
+            fprintf(out, "%s\n", line);
+        }
+    }
+
+    /* Monotonic wall clock in nanoseconds */
+    static uint64_t now() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+            steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    LatencyHistogram hist_[LATENCY_PATHS];
+};
+
+/*
+ * Times the enclosing scope into one histogram. A NULL set costs a
+ * single test, so agents without histograms pay nothing else.
+ */
+class LatencyScope {
+public:
+    LatencyScope(BatmanLatency *set, LatencyPath path) :
+        hist_(set ? &(*set)[path] : NULL),
+        start_(set ? BatmanLatency::now() : 0) {}
+
+    ~LatencyScope() {
+        if (hist_ != NULL)
+            hist_->record(BatmanLatency::now() - start_);
+    }
+
+private:
+    LatencyHistogram *hist_;
+    uint64_t start_;
+
+    LatencyScope(const LatencyScope&);
+    LatencyScope& operator=(const LatencyScope&);
+};
+
+#endif /* __batman_histogram_h__ */
@@ -0,0 +1,200 @@
+/*
+ * batman_lpm.h
+ * B.A.T.M.A.N. Longest-Prefix-Match Table
+ *
+ * Multibit trie over IPv4 prefixes with an 8-bit stride: a lookup is at
+ * most four array indexings regardless of how many HNA prefixes are
+ * announced. Prefixes that end inside a stride are expanded over every
+ * slot they cover (controlled prefix expansion).
+ */
+
+#ifndef __batman_lpm_h__
+#define __batman_lpm_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+/*
+ * Several originators may announce the same prefix (two gateways both
+ * announcing 0/0), so every prefix keeps the set of its announcers and
+ * the trie slots name that set. Inserting or withdrawing one announcer
+ * touches only the slots of its own prefix.
+ */
+template <class Value>
+class PrefixTrie {
+public:
+    typedef std::vector<Value> Announcers;
+
+    PrefixTrie() { clear(); }
+
+    /* Add value as an announcer of network/len */
+    void insert(uint32_t network, uint8_t len, const Value &value) {
+        if (len > 32)
+            len = 32;
+        network &= mask(len);
+        std::pair<typename Prefixes::iterator, bool> ins =
+            prefixes_.insert(std::make_pair(Key(network, len), (int32_t)-1));
+        if (ins.second) {
+            ins.first->second = allocSet();
+            expand(network, len, ins.first->second);
+        }
+        Announcers &set = sets_[ins.first->second];
+        if (std::find(set.begin(), set.end(), value) == set.end())
+            set.push_back(value);
+    }
+
+    /* Withdraw value's announcement of network/len */
+    void remove(uint32_t network, uint8_t len, const Value &value) {
+        if (len > 32)
+            len = 32;
+        network &= mask(len);
+        typename Prefixes::iterator it = prefixes_.find(Key(network, len));
+        if (it == prefixes_.end())
+            return;
+        Announcers &set = sets_[it->second];
+        typename Announcers::iterator v = std::find(set.begin(), set.end(),
+                                                    value);
+        if (v == set.end())
+            return;
+        set.erase(v);
+        if (!set.empty())
+            return;
+
+        // Last announcer gone: its slots fall back to the next shorter
+        // prefix ending in the same stride, or to empty
+        int32_t id = it->second;
+        prefixes_.erase(it);
+        withdraw(network, len, id);
+        free_.push_back(id);
+    }
+
+    /* Announcers of the longest prefix containing addr, NULL if none */
+    const Announcers* lookup(uint32_t addr) const {
+        int32_t best = -1;
+        int32_t node = 0;
+        for (int level = 0; level < LEVELS && node >= 0; level++) {
+            const Slot &s = nodes_[node].slots_[(addr >> (24 - 8 * level)) & 0xff];
+            if (s.len_ != 0)
+                best = s.set_;
+            node = s.child_;
+        }
+        return best < 0 ? NULL : &sets_[best];
+    }
+
+    void clear() {
+        prefixes_.clear();
+        sets_.clear();
+        free_.clear();
+        nodes_.assign(1, Node());
+    }
+
+    size_t size() const { return prefixes_.size(); }
+
+private:
+    enum { LEVELS = 4 };
+
+    struct Slot {
+        int32_t child_;   // Next-level node, -1 if none
+        uint8_t len_;     // Stored prefix length + 1, 0 if empty
+        int32_t set_;     // Index into sets_
+        Slot() : child_(-1), len_(0), set_(-1) {}
+    };
+
+    struct Node {
+        Slot slots_[256];
+    };
+
+    typedef std::pair<uint32_t, uint8_t> Key;
+    typedef std::map<Key, int32_t> Prefixes;
+
+    /* Sets are named by index so a copied trie (a snapshot) stays valid */
+    Prefixes prefixes_;              // Prefix -> its announcer set
+    std::vector<Announcers> sets_;
+    std::vector<int32_t> free_;      // Unused entries of sets_
+    std::vector<Node> nodes_;        // nodes_[0] is the root
+
+    static uint32_t mask(uint8_t len) {
+        return len == 0 ? 0 : 0xffffffffu << (32 - len);
+    }
+
+    static int levelOf(uint8_t len) { return (len == 0) ? 0 : (len - 1) / 8; }
+
+    int32_t allocSet() {
+        if (free_.empty()) {
+            sets_.push_back(Announcers());
+            return (int32_t)sets_.size() - 1;
+        }
+        int32_t id = free_.back();
+        free_.pop_back();
+        return id;
+    }
+
+    /* Node holding the last level of network/len, created on the way */
+    int32_t walk(uint32_t network, int level) {
+        int32_t node = 0;
+        for (int l = 0; l < level; l++) {
+            uint32_t idx = (network >> (24 - 8 * l)) & 0xff;
+            if (nodes_[node].slots_[idx].child_ < 0) {
+                nodes_.push_back(Node());
+                nodes_[node].slots_[idx].child_ = (int32_t)nodes_.size() - 1;
+            }
+            node = nodes_[node].slots_[idx].child_;
+        }
+        return node;
+    }
+
+    /* Write network/len into every slot it covers at its last level */
+    void expand(uint32_t network, uint8_t len, int32_t id) {
+        int level = levelOf(len);
+        int32_t node = walk(network, level);
+
+        int span = 8 * (level + 1) - len;
+        uint32_t first = ((network >> (24 - 8 * level)) & 0xff) & ~((1u << span) - 1);
+        for (uint32_t idx = first; idx < first + (1u << span); idx++) {
+            Slot &s = nodes_[node].slots_[idx];
+            if (s.len_ <= len + 1) {
+                s.len_ = len + 1;
+                s.set_ = id;
+            }
+        }
+    }
+
+    /*
+     * Hand the slots network/len held to the longest remaining prefix
+     * that ends in the same stride and covers them; they all share the
+     * same first len bits, so one candidate serves the whole span.
+     */
+    void withdraw(uint32_t network, uint8_t len, int32_t id) {
+        int level = levelOf(len);
+        int32_t node = walk(network, level);
+
+        uint8_t cover_len = 0;
+        int32_t cover = -1;
+        int shortest = (level == 0) ? 0 : 8 * level + 1;
+        for (int l = len - 1; l >= shortest; l--) {
+            typename Prefixes::const_iterator it =
+                prefixes_.find(Key(network & mask((uint8_t)l), (uint8_t)l));
+            if (it != prefixes_.end()) {
+                cover_len = (uint8_t)(l + 1);
+                cover = it->second;
+                break;
+            }
+        }
+
+        int span = 8 * (level + 1) - len;
+        uint32_t first = ((network >> (24 - 8 * level)) & 0xff) & ~((1u << span) - 1);
+        for (uint32_t idx = first; idx < first + (1u << span); idx++) {
+            Slot &s = nodes_[node].slots_[idx];
+            if (s.len_ == len + 1 && s.set_ == id) {
+                s.len_ = cover_len;
+                s.set_ = cover;
+            }
+        }
+    }
+};
+
+#endif /* __batman_lpm_h__ */
@@ -9,29 +9,20 @@
 
 #include <packet.h>
 
-/* Protocol Constants */
-#define BATMAN_VERSION 4
-#define BATMAN_PORT 4305
-#define TTL_MIN 2
-#define TTL_MAX 255
-#define SEQNO_MAX 65535
+#include "batman_const.h"
+#include "batman_tlv.h"
 
-/* Timing Constants (in seconds) */
-#define ORIGINATOR_INTERVAL 1.0
-#define ORIGINATOR_INTERVAL_JITTER 0.2
-#define WINDOW_SIZE 128
-#define PURGE_TIMEOUT (10 * WINDOW_SIZE * ORIGINATOR_INTERVAL)
-#define BROADCAST_DELAY_MAX 0.1
-#define BI_LINK_TIMEOUT (3 * ORIGINATOR_INTERVAL)
+/* Recycled OGM packets kept per agent */
+#define OGM_POOL_MAX 32
+
+/* OGM Aggregation */
+#define MAX_AGGREGATION_BYTES 512
+#define MAX_AGGREGATION_DELAY BROADCAST_DELAY_MAX
 
 /* Packet Types */
 #define BATMANTYPE_OGM 0x01
 #define BATMANTYPE_HNA 0x02
 
-/* Flags */
-#define BATMAN_FLAG_DIRECTLINK 0x40
-#define BATMAN_FLAG_UNIDIRECTIONAL 0x20
-
 /* OGM Header Structure - 12 bytes */
 struct hdr_batman_ogm {
     u_int8_t  version_;
@@ -64,8 +55,35 @@ struct hdr_batman_ogm {
     inline void set_unidirectional() { flags_ |= BATMAN_FLAG_UNIDIRECTIONAL; }
     inline void clear_directlink() { flags_ &= ~BATMAN_FLAG_DIRECTLINK; }
     inline void clear_unidirectional() { flags_ &= ~BATMAN_FLAG_UNIDIRECTIONAL; }
+    
+    /* Fixed fields to and from a TLV-format message */
+    void to_tlv(TlvMessage &m) {
+        m.version_ = version_;
+        m.flags_ = flags_;
+        m.ttl_ = ttl_;
+        m.gw_flags_ = gw_flags_;
+        m.seqno_ = seqno_;
+        m.gw_port_ = gw_port_;
+        m.orig_ = (u_int32_t)orig_addr_;
+    }
+    void from_tlv(const TlvMessage &m) {
+        version_ = m.version_;
+        flags_ = m.flags_;
+        ttl_ = m.ttl_;
+        gw_flags_ = m.gw_flags_;
+        seqno_ = m.seqno_;
+        gw_port_ = m.gw_port_;
+        orig_addr_ = (nsaddr_t)m.orig_;
+    }
 };
 
+/*
+ * TLV-format OGMs (version BATMAN_TLV_VERSION, see batman_tlv.h) carry
+ * their encoded messages in the packet data, one or several back to
+ * back. hdr_batman_ogm mirrors the fixed fields of the first message and
+ * the common header size is IP_HDR_LEN plus the exact encoded length.
+ */
+
 /* HNA Header Structure - 5 bytes */
 struct hdr_batman_hna {
     nsaddr_t  network_addr_;
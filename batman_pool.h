@@ -0,0 +1,81 @@
+/*
+ * batman_pool.h
+ * B.A.T.M.A.N. Object Pool
+ *
+ * Slab allocator with free-list reuse for routing-state objects. Each
+ * agent owns its pools, so originator and neighbor churn recycles the
+ * same memory instead of hitting the heap once per entry.
+ */
+
+#ifndef __batman_pool_h__
+#define __batman_pool_h__
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+template <class T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t slab_objects = 64) :
+        slab_objects_(slab_objects), free_(NULL), in_use_(0) {}
+
+    /* Every object must have been destroyed before the pool goes away */
+    ~ObjectPool() {
+        for (size_t i = 0; i < slabs_.size(); i++)
+            delete[] slabs_[i];
+    }
+
+    /* Default-construct a T in a free slot */
+    T* create() {
+        if (free_ == NULL)
+            grow();
+        Node *n = free_;
+        free_ = n->next_;
+        in_use_++;
+        return new (n->storage_) T();
+    }
+
+    /* Destroy obj and put its slot back on the free list */
+    void destroy(T *obj) {
+        if (obj == NULL)
+            return;
+        obj->~T();
+        Node *n = reinterpret_cast<Node*>(obj);
+        n->next_ = free_;
+        free_ = n;
+        in_use_--;
+    }
+
+    size_t objectsInUse() const { return in_use_; }
+    size_t bytesInUse() const { return in_use_ * sizeof(Node); }
+    size_t bytesReserved() const {
+        return slabs_.size() * slab_objects_ * sizeof(Node);
+    }
+
+private:
+    union Node {
+        Node *next_;                        // While on the free list
+        alignas(T) unsigned char storage_[sizeof(T)];
+    };
+
+    size_t slab_objects_;        // Objects carved from each slab
+    std::vector<Node*> slabs_;
+    Node *free_;
+    size_t in_use_;
+
+    /* Allocate one slab and thread its slots onto the free list */
+    void grow() {
+        Node *slab = new Node[slab_objects_];
+        slabs_.push_back(slab);
+        for (size_t i = slab_objects_; i > 0; i--) {
+            slab[i - 1].next_ = free_;
+            free_ = &slab[i - 1];
+        }
+    }
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+};
+
+#endif /* __batman_pool_h__ */
@@ -0,0 +1,173 @@
+/*
+ * batman_rcu.h
+ * B.A.T.M.A.N. Route Snapshots
+ *
+ * Read-copy-update publication of the forwarding table. The control
+ * thread copies the table after route changes and swaps the copy in with
+ * one atomic store; data-plane threads look routes up in whichever copy
+ * is current without taking a lock. Replaced copies are freed once no
+ * reader can still hold them (epoch-based reclamation).
+ */
+
+#ifndef __batman_rcu_h__
+#define __batman_rcu_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "batman_fib.h"
+
+/* Reader slots per epoch domain, one per data-plane thread */
+#define RCU_MAX_READERS 64
+
+/*
+ * A reader records the global epoch when it enters a read section and
+ * clears it on exit. The writer tags each unlinked object with the epoch
+ * current at unlink time and advances the epoch; an object can be freed
+ * once every reader inside a read section entered in a later epoch.
+ */
+class EpochDomain {
+public:
+    EpochDomain() : epoch_(1) {
+        for (int i = 0; i < RCU_MAX_READERS; i++) {
+            slots_[i].epoch_.store(0);
+            slots_[i].claimed_.store(false);
+        }
+    }
+
+    /* Claim a reader slot; -1 if all are taken */
+    int registerReader() {
+        for (int i = 0; i < RCU_MAX_READERS; i++) {
+            bool expected = false;
+            if (slots_[i].claimed_.compare_exchange_strong(expected, true))
+                return i;
+        }
+        return -1;
+    }
+
+    void unregisterReader(int reader) {
+        slots_[reader].epoch_.store(0);
+        slots_[reader].claimed_.store(false);
+    }
+
+    void enter(int reader) { slots_[reader].epoch_.store(epoch_.load()); }
+    void exit(int reader) { slots_[reader].epoch_.store(0); }
+
+    /* Writer: close the current epoch and return its number */
+    uint64_t advance() { return epoch_.fetch_add(1); }
+
+    /* Writer: oldest epoch a reader is still inside, UINT64_MAX if none */
+    uint64_t oldestActive() const {
+        uint64_t oldest = UINT64_MAX;
+        for (int i = 0; i < RCU_MAX_READERS; i++) {
+            uint64_t e = slots_[i].epoch_.load();
+            if (e != 0 && e < oldest)
+                oldest = e;
+        }
+        return oldest;
+    }
+
+private:
+    struct Slot {                     // Padded to a cache line per reader
+        std::atomic<uint64_t> epoch_;  // 0 while outside a read section
+        std::atomic<bool> claimed_;
+        char pad_[64 - sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<bool>)];
+    };
+
+    std::atomic<uint64_t> epoch_;
+    Slot slots_[RCU_MAX_READERS];
+
+    EpochDomain(const EpochDomain&);
+    EpochDomain& operator=(const EpochDomain&);
+};
+
+/*
+ * Versioned copies of a ForwardingTable. publish() and reclaim() belong
+ * to the single control thread; lookup() may be called concurrently from
+ * any thread holding a reader slot. A snapshot is never modified after
+ * it has been published.
+ */
+template <class Addr, class Index = FlatIndex<Addr> >
+class RouteSnapshots {
+public:
+    typedef ForwardingTable<Addr, Index> Table;
+
+    struct Snapshot {
+        uint64_t version_;
+        Table table_;
+        Snapshot(uint64_t version, const Table &table) :
+            version_(version), table_(table) {}
+    };
+
+    RouteSnapshots() : current_(NULL), version_(0) {}
+
+    /* Readers must have stopped before the snapshots go away */
+    ~RouteSnapshots() {
+        delete current_.load();
+        for (size_t i = 0; i < retired_.size(); i++)
+            delete retired_[i].first;
+    }
+
+    /* Control thread: make a copy of table the current version */
+    void publish(const Table &table) {
+        const Snapshot *old = current_.exchange(new Snapshot(++version_, table));
+        if (old != NULL)
+            retired_.push_back(Retired(old, epochs_.advance()));
+        reclaim();
+    }
+
+    /* Control thread: free retired versions no reader can still see */
+    void reclaim() {
+        if (retired_.empty())
+            return;
+        uint64_t oldest = epochs_.oldestActive();
+        size_t kept = 0;
+        for (size_t i = 0; i < retired_.size(); i++) {
+            if (retired_[i].second < oldest)
+                delete retired_[i].first;
+            else
+                retired_[kept++] = retired_[i];
+        }
+        retired_.resize(kept);
+    }
+
+    int registerReader() { return epochs_.registerReader(); }
+    void unregisterReader(int reader) { epochs_.unregisterReader(reader); }
+
+    /*
+     * Reader: next hop towards dest in the current version. version, if
+     * given, receives the version answered from (0 if none published).
+     */
+    bool lookup(int reader, const Addr &dest, Addr &next_hop,
+                uint64_t *version = NULL) {
+        epochs_.enter(reader);
+        const Snapshot *s = current_.load();
+        bool found = (s != NULL && s->table_.lookup(dest, next_hop));
+        if (version != NULL)
+            *version = (s != NULL) ? s->version_ : 0;
+        epochs_.exit(reader);
+        return found;
+    }
+
+    /* Latest published version, 0 before the first publish */
+    uint64_t version() const { return version_; }
+
+    /* Versions waiting for readers to move on */
+    size_t retired() const { return retired_.size(); }
+
+private:
+    typedef std::pair<const Snapshot*, uint64_t> Retired;   // (copy, epoch)
+
+    std::atomic<const Snapshot*> current_;
+    EpochDomain epochs_;
+    std::vector<Retired> retired_;   // Control thread only
+    uint64_t version_;
+
+    RouteSnapshots(const RouteSnapshots&);
+    RouteSnapshots& operator=(const RouteSnapshots&);
+};
+
+#endif /* __batman_rcu_h__ */
@@ -0,0 +1,93 @@
+/*
+ * batman_small_vector.h
+ * B.A.T.M.A.N. Inline Small Vector
+ *
+ * Contiguous container holding up to N elements inside its owner and
+ * spilling to the heap beyond that. Used for the per-originator neighbor
+ * records, which are nearly always only a handful.
+ */
+
+#ifndef __batman_small_vector_h__
+#define __batman_small_vector_h__
+
+#include <stddef.h>
+#include <new>
+
+template <class T, size_t N>
+class SmallVector {
+public:
+    SmallVector() : data_(inline_ptr()), size_(0), capacity_(N) {}
+
+    ~SmallVector() {
+        clear();
+        if (data_ != inline_ptr())
+            ::operator delete(data_);
+    }
+
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool spilled() const { return data_ != inline_ptr(); }
+
+    /* Append a default-constructed element; may move all elements */
+    T& emplace_back() {
+        if (size_ == capacity_)
+            grow();
+        T *obj = new (data_ + size_) T();
+        size_++;
+        return *obj;
+    }
+
+    /* Remove element i by moving the last one into its place */
+    void swap_remove(size_t i) {
+        if (i != size_ - 1)
+            data_[i] = data_[size_ - 1];
+        data_[size_ - 1].~T();
+        size_--;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < size_; i++)
+            data_[i].~T();
+        size_ = 0;
+    }
+
+private:
+    union Storage {
+        alignas(T) unsigned char bytes_[sizeof(T) * N];
+    };
+
+    T *data_;            // Inline storage or heap spill area
+    size_t size_;
+    size_t capacity_;
+    Storage inline_;
+
+    T* inline_ptr() { return reinterpret_cast<T*>(inline_.bytes_); }
+    const T* inline_ptr() const {
+        return reinterpret_cast<const T*>(inline_.bytes_);
+    }
+
+    /* Spill-over path: double the capacity on the heap */
+    void grow() {
+        size_t capacity = capacity_ * 2;
+        T *data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+        for (size_t i = 0; i < size_; i++) {
+            new (data + i) T(data_[i]);
+            data_[i].~T();
+        }
+        if (data_ != inline_ptr())
+            ::operator delete(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    SmallVector(const SmallVector&);
+    SmallVector& operator=(const SmallVector&);
+};
+
+#endif /* __batman_small_vector_h__ */
@@ -0,0 +1,57 @@
+/*
+ * batman_stats.h
+ * B.A.T.M.A.N. Per-Agent Counters
+ *
+ * Counters for the OGM and data paths. The protocol core owns one block
+ * and counts what it decides on; the NS2 agent and NS3 protocol count
+ * what only they see (sending, forwarding, data packets) in the same
+ * block, so one agent's numbers are read and reset together.
+ */
+
+#ifndef __batman_stats_h__
+#define __batman_stats_h__
+
+#include <stdint.h>
+
+/*
+ * Plain counters: each agent runs in one thread, so an update is one
+ * increment on the hot path. Table sizes are not counted here; they are
+ * read from the core when reporting.
+ */
+struct BatmanStats {
+    uint64_t ogm_sent_;             // Own OGMs originated
+    uint64_t ogm_received_;         // OGMs handed to the core
+    uint64_t ogm_duplicate_;        // Seqno already logged
+    uint64_t ogm_unidirectional_;   // Flagged, or failed the link check
+    uint64_t ogm_forwarded_;        // Rebroadcast
+    uint64_t data_forwarded_;       // Data packets sent on to a next hop
+    uint64_t data_no_route_;        // Data packets dropped without route
+    uint64_t route_changes_;        // Best next hop set, changed or lost
+
+    BatmanStats() { reset(); }
+
+    void reset() {
+        ogm_sent_ = 0;
+        ogm_received_ = 0;
+        ogm_duplicate_ = 0;
+        ogm_unidirectional_ = 0;
+        ogm_forwarded_ = 0;
+        data_forwarded_ = 0;
+        data_no_route_ = 0;
+        route_changes_ = 0;
+    }
+
+    /* Sum another agent's counters into these */
+    void merge(const BatmanStats &o) {
+        ogm_sent_ += o.ogm_sent_;
+        ogm_received_ += o.ogm_received_;
+        ogm_duplicate_ += o.ogm_duplicate_;
+        ogm_unidirectional_ += o.ogm_unidirectional_;
+        ogm_forwarded_ += o.ogm_forwarded_;
+        data_forwarded_ += o.data_forwarded_;
+        data_no_route_ += o.data_no_route_;
+        route_changes_ += o.route_changes_;
+    }
+};
+
+#endif /* __batman_stats_h__ */
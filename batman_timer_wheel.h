@@ -0,0 +1,130 @@
+/*
+ * batman_timer_wheel.h
+ * B.A.T.M.A.N. Hierarchical Timer Wheel
+ *
+ * Expiration scheduling for originators, neighbors and broadcast-log
+ * entries. Advancing the wheel only touches the slots that come due, so
+ * a purge tick costs O(expired entries) instead of a full-table pass.
+ */
+
+#ifndef __batman_timer_wheel_h__
+#define __batman_timer_wheel_h__
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+/* What an expiration item refers to */
+enum ExpiryKind {
+    EXPIRE_ORIGINATOR,   // OriginatorEntry last_aware_time_
+    EXPIRE_NEIGHBOR,     // NeighborInfo last_valid_time_
+    EXPIRE_BCAST_LOG     // Broadcast log of one originator
+};
+
+/*
+ * Items are plain values naming the entry they refer to. The owner
+ * re-checks the entry's own timestamp when an item fires and either
+ * removes it or schedules it again, so refreshing an entry on every OGM
+ * never has to touch the wheel. id_ tells a re-created entry apart from
+ * the one the item was scheduled for.
+ */
+template <class Addr>
+struct ExpiryItem {
+    ExpiryKind kind_;
+    Addr orig_;
+    Addr neighbor_;
+    uint32_t id_;
+
+    ExpiryItem() : kind_(EXPIRE_ORIGINATOR), orig_(), neighbor_(), id_(0) {}
+    ExpiryItem(ExpiryKind kind, const Addr &orig, const Addr &neighbor,
+               uint32_t id) :
+        kind_(kind), orig_(orig), neighbor_(neighbor), id_(id) {}
+};
+
+/*
+ * Three levels of 64 slots. With a one second tick level 0 resolves the
+ * next minute, level 1 about an hour and level 2 about three days;
+ * anything further out is parked in the last slot and re-armed by the
+ * owner when it fires early.
+ */
+template <class Item>
+class TimerWheel {
+public:
+    explicit TimerWheel(double tick = 1.0) : tick_(tick), now_tick_(0) {}
+
+    void setTick(double tick) { tick_ = tick; }
+    double tick() const { return tick_; }
+
+    /* Schedule item to fire once the wheel has advanced past when */
+    void schedule(const Item &item, double when) {
+        int64_t t = (int64_t)ceil(when / tick_);
+        if (t <= now_tick_)
+            t = now_tick_ + 1;
+        insert(Slot(item, t));
+    }
+
+    /* Advance to time now, appending every item that came due to due */
+    void advance(double now, std::vector<Item> &due) {
+        int64_t target = (int64_t)floor(now / tick_);
+        while (now_tick_ < target) {
+            now_tick_++;
+
+            if ((now_tick_ & SLOT_MASK) == 0) {
+                if (((now_tick_ >> SLOT_BITS) & SLOT_MASK) == 0)
+                    cascade(2, (now_tick_ >> (2 * SLOT_BITS)) & SLOT_MASK);
+                cascade(1, (now_tick_ >> SLOT_BITS) & SLOT_MASK);
+            }
+
+            std::vector<Slot> &slot = levels_[0][now_tick_ & SLOT_MASK];
+            for (size_t i = 0; i < slot.size(); i++)
+                due.push_back(slot[i].item_);
+            slot.clear();
+        }
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (int l = 0; l < LEVELS; l++)
+            for (int s = 0; s < SLOTS; s++)
+                n += levels_[l][s].size();
+        return n;
+    }
+
+private:
+    enum { LEVELS = 3, SLOT_BITS = 6, SLOTS = 1 << SLOT_BITS,
+           SLOT_MASK = SLOTS - 1 };
+
+    struct Slot {
+        Item item_;
+        int64_t tick_;   // Absolute tick the item is due at
+        Slot(const Item &item, int64_t tick) : item_(item), tick_(tick) {}
+    };
+
+    std::vector<Slot> levels_[LEVELS][SLOTS];
+    double tick_;        // Seconds per tick
+    int64_t now_tick_;   // Last tick processed
+
+    void insert(Slot s) {
+        int64_t delta = s.tick_ - now_tick_;
+        if (delta < SLOTS) {
+            levels_[0][s.tick_ & SLOT_MASK].push_back(s);
+        } else if (delta < ((int64_t)1 << (2 * SLOT_BITS))) {
+            levels_[1][(s.tick_ >> SLOT_BITS) & SLOT_MASK].push_back(s);
+        } else {
+            int64_t max_delta = ((int64_t)1 << (3 * SLOT_BITS)) - 1;
+            if (delta > max_delta)
+                s.tick_ = now_tick_ + max_delta;
+            levels_[2][(s.tick_ >> (2 * SLOT_BITS)) & SLOT_MASK].push_back(s);
+        }
+    }
+
+    /* Re-file the items of a higher level slot one level down */
+    void cascade(int level, int64_t index) {
+        std::vector<Slot> moved;
+        moved.swap(levels_[level][index]);
+        for (size_t i = 0; i < moved.size(); i++)
+            insert(moved[i]);
+    }
+};
+
+#endif /* __batman_timer_wheel_h__ */
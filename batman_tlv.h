@@ -0,0 +1,246 @@
+/*
+ * batman_tlv.h
+ * B.A.T.M.A.N. TLV Message Codec
+ *
+ * Variable-length OGM format: the fixed OGM fields followed by a block
+ * of type-length-value extensions, so one message carries an originator
+ * together with its whole HNA list, its TQ and any later extension.
+ * Extensions a node does not know are kept and relayed unchanged.
+ *
+ *  0                   1                   2                   3
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |    Version    |U|D|           |      TTL      |    GWFlags    |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |        Sequence Number        |             GW Port           |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |                      Originator Address                       |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * |       Extension Length        |     Type      |    Length     |
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ * :                     Value ... (more TLVs)                     :
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * The first 12 octets match the fixed OGM, so TTL and flags sit at the
+ * same offsets and a relay can patch them without decoding the rest.
+ * All fields are in network byte order.
+ */
+
+#ifndef __batman_tlv_h__
+#define __batman_tlv_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+/* Version octet of a TLV message (fixed-format OGMs are version 4) */
+#define BATMAN_TLV_VERSION 5
+
+/* Octets before the first extension, and offsets of patchable fields */
+#define BATMAN_TLV_FIXED_LEN 14
+#define BATMAN_TLV_OFFSET_FLAGS 1
+#define BATMAN_TLV_OFFSET_TTL 2
+
+/* Extension types */
+#define TLV_HNA 1            // (network/32, netmask/8) pairs
+#define TLV_HNA_COMPACT 2    // (network low 16 bits, netmask/8) pairs
+#define TLV_TQ 3             // Transmit quality, one octet
+
+/* HNA entries per TLV; a longer list is split over several TLVs */
+#define TLV_HNA_ENTRY_LEN 5
+#define TLV_HNA_COMPACT_ENTRY_LEN 3
+#define TLV_HNA_MAX_ENTRIES (255 / TLV_HNA_ENTRY_LEN)
+#define TLV_HNA_COMPACT_MAX_ENTRIES (255 / TLV_HNA_COMPACT_ENTRY_LEN)
+
+/*
+ * One OGM with its extensions. Addresses are 32-bit host-order values.
+ * An HNA network sharing its upper 16 bits with the originator address
+ * is sent in compact form, which only carries the lower 16 bits.
+ */
+struct TlvMessage {
+    uint8_t version_;
+    uint8_t flags_;
+    uint8_t ttl_;
+    uint8_t gw_flags_;
+    uint16_t seqno_;
+    uint16_t gw_port_;
+    uint32_t orig_;
+    std::vector<std::pair<uint32_t, uint8_t> > hna_;   // (network, netmask)
+    bool has_tq_;
+    uint8_t tq_;
+    std::vector<std::pair<uint8_t, std::vector<uint8_t> > > unknown_;
+
+    TlvMessage() :
+        version_(BATMAN_TLV_VERSION), flags_(0), ttl_(0), gw_flags_(0),
+        seqno_(0), gw_port_(0), orig_(0), has_tq_(false), tq_(0) {}
+
+    bool isCompact(uint32_t network) const {
+        return (network >> 16) == (orig_ >> 16);
+    }
+};
+
+/* Number of TLVs needed for n entries at max per TLV */
+inline size_t tlvCount(size_t n, size_t max) {
+    return (n + max - 1) / max;
+}
+
+/* Exact encoded size of m */
+inline size_t tlvSize(const TlvMessage &m) {
+    size_t compact = 0;
+    for (size_t i = 0; i < m.hna_.size(); i++) {
+        if (m.isCompact(m.hna_[i].first))
+            compact++;
+    }
+    size_t full = m.hna_.size() - compact;
+
+    size_t len = BATMAN_TLV_FIXED_LEN;
+    len += 2 * tlvCount(full, TLV_HNA_MAX_ENTRIES) + full * TLV_HNA_ENTRY_LEN;
+    len += 2 * tlvCount(compact, TLV_HNA_COMPACT_MAX_ENTRIES) +
+           compact * TLV_HNA_COMPACT_ENTRY_LEN;
+    if (m.has_tq_)
+        len += 3;
+    for (size_t i = 0; i < m.unknown_.size(); i++)
+        len += 2 + m.unknown_[i].second.size();
+    return len;
+}
+
+inline uint8_t* tlvPut16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+    return p + 2;
+}
+
+inline uint8_t* tlvPut32(uint8_t *p, uint32_t v) {
+    p = tlvPut16(p, (uint16_t)(v >> 16));
+    return tlvPut16(p, (uint16_t)v);
+}
+
+inline uint16_t tlvGet16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+inline uint32_t tlvGet32(const uint8_t *p) {
+    return ((uint32_t)tlvGet16(p) << 16) | tlvGet16(p + 2);
+}
+
+/* Write the HNA entries of one form (compact or not) as TLVs */
+inline uint8_t* tlvPutHna(uint8_t *p, const TlvMessage &m, bool compact) {
+    uint8_t type = compact ? TLV_HNA_COMPACT : TLV_HNA;
+    size_t entry = compact ? TLV_HNA_COMPACT_ENTRY_LEN : TLV_HNA_ENTRY_LEN;
+    size_t max = compact ? TLV_HNA_COMPACT_MAX_ENTRIES : TLV_HNA_MAX_ENTRIES;
+
+    uint8_t *tlv = NULL;
+    size_t in_tlv = 0;
+    for (size_t i = 0; i < m.hna_.size(); i++) {
+        if (m.isCompact(m.hna_[i].first) != compact)
+            continue;
+        if (tlv == NULL || in_tlv == max) {
+            tlv = p;
+            tlv[0] = type;
+            tlv[1] = 0;
+            p += 2;
+            in_tlv = 0;
+        }
+        if (compact)
+            p = tlvPut16(p, (uint16_t)m.hna_[i].first);
+        else
+            p = tlvPut32(p, m.hna_[i].first);
+        *p++ = m.hna_[i].second;
+        tlv[1] = (uint8_t)(tlv[1] + entry);
+        in_tlv++;
+    }
+    return p;
+}
+
+/* Encode m into buf, which must hold tlvSize(m) octets; returns that size */
+inline size_t tlvEncode(const TlvMessage &m, uint8_t *buf) {
+    uint8_t *p = buf;
+    *p++ = m.version_;
+    *p++ = m.flags_;
+    *p++ = m.ttl_;
+    *p++ = m.gw_flags_;
+    p = tlvPut16(p, m.seqno_);
+    p = tlvPut16(p, m.gw_port_);
+    p = tlvPut32(p, m.orig_);
+    uint8_t *ext_len = p;
+    p += 2;
+
+    p = tlvPutHna(p, m, false);
+    p = tlvPutHna(p, m, true);
+    if (m.has_tq_) {
+        *p++ = TLV_TQ;
+        *p++ = 1;
+        *p++ = m.tq_;
+    }
+    for (size_t i = 0; i < m.unknown_.size(); i++) {
+        const std::vector<uint8_t> &value = m.unknown_[i].second;
+        *p++ = m.unknown_[i].first;
+        *p++ = (uint8_t)value.size();
+        if (!value.empty())
+            memcpy(p, &value[0], value.size());
+        p += value.size();
+    }
+
+    tlvPut16(ext_len, (uint16_t)(p - ext_len - 2));
+    return p - buf;
+}
+
+/*
+ * Decode one message from the len octets at buf. Returns the octets it
+ * occupied, so messages packed back to back can be walked, or 0 if the
+ * message is truncated or malformed.
+ */
+inline size_t tlvDecode(const uint8_t *buf, size_t len, TlvMessage &m) {
+    if (len < BATMAN_TLV_FIXED_LEN)
+        return 0;
+    size_t ext_len = tlvGet16(buf + 12);
+    if (ext_len > len - BATMAN_TLV_FIXED_LEN)
+        return 0;
+
+    m = TlvMessage();
+    m.version_ = buf[0];
+    m.flags_ = buf[1];
+    m.ttl_ = buf[2];
+    m.gw_flags_ = buf[3];
+    m.seqno_ = tlvGet16(buf + 4);
+    m.gw_port_ = tlvGet16(buf + 6);
+    m.orig_ = tlvGet32(buf + 8);
+
+    const uint8_t *p = buf + BATMAN_TLV_FIXED_LEN;
+    const uint8_t *end = p + ext_len;
+    while (p < end) {
+        if (end - p < 2 || (size_t)(end - p - 2) < p[1])
+            return 0;
+        uint8_t type = p[0];
+        size_t vlen = p[1];
+        const uint8_t *v = p + 2;
+        p += 2 + vlen;
+
+        if (type == TLV_HNA) {
+            if (vlen % TLV_HNA_ENTRY_LEN != 0)
+                return 0;
+            for (; v < p; v += TLV_HNA_ENTRY_LEN)
+                m.hna_.push_back(std::make_pair(tlvGet32(v), v[4]));
+        } else if (type == TLV_HNA_COMPACT) {
+            if (vlen % TLV_HNA_COMPACT_ENTRY_LEN != 0)
+                return 0;
+            for (; v < p; v += TLV_HNA_COMPACT_ENTRY_LEN) {
+                uint32_t network = (m.orig_ & 0xffff0000u) | tlvGet16(v);
+                m.hna_.push_back(std::make_pair(network, v[2]));
+            }
+        } else if (type == TLV_TQ) {
+            if (vlen != 1)
+                return 0;
+            m.has_tq_ = true;
+            m.tq_ = v[0];
+        } else {
+            m.unknown_.push_back(std::make_pair(type,
+                                 std::vector<uint8_t>(v, p)));
+        }
+    }
+    return BATMAN_TLV_FIXED_LEN + ext_len;
+}
+
+#endif /* __batman_tlv_h__ */
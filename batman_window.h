@@ -0,0 +1,101 @@
+/*
+ * batman_window.h
+ * B.A.T.M.A.N. Sliding Window Bitmap
+ *
+ * Fixed-size ring bitmap of received sequence numbers. Shared by the
+ * NS2 and NS3 NeighborInfo implementations, so it depends on nothing
+ * but <stdint.h>.
+ */
+
+#ifndef __batman_window_h__
+#define __batman_window_h__
+
+#include <stdint.h>
+
+/* Number of sequence numbers tracked by a window (RFC WINDOW_SIZE) */
+#define BATMAN_WINDOW_BITS 128
+
+/*
+ * Bit i of the bitmap stands for sequence number (newest_ - i). Receiving
+ * a newer sequence number shifts the bitmap by the distance advanced, so
+ * entries falling out of the window are dropped by the shift itself and
+ * no per-seqno bookkeeping or allocation is needed.
+ */
+class SeqnoWindow {
+public:
+    SeqnoWindow() { reset(); }
+
+    void reset() {
+        bits_[0] = 0;
+        bits_[1] = 0;
+        newest_ = 0;
+        empty_ = true;
+    }
+
+    /* Mark seqno as received, sliding the window if it is the newest */
+    void mark(uint16_t seqno) {
+        if (empty_) {
+            newest_ = seqno;
+            bits_[0] = 1;
+            empty_ = false;
+            return;
+        }
+
+        uint16_t ahead = (uint16_t)(seqno - newest_);
+        if (ahead != 0 && ahead < 0x8000) {
+            shift(ahead);
+            newest_ = seqno;
+            bits_[0] |= 1;
+            return;
+        }
+
+        uint16_t behind = (uint16_t)(newest_ - seqno);
+        if (behind < BATMAN_WINDOW_BITS)
+            bits_[behind >> 6] |= ((uint64_t)1 << (behind & 63));
+    }
+
+    /* True if seqno was received and is still inside the window */
+    bool isSet(uint16_t seqno) const {
+        if (empty_)
+            return false;
+        uint16_t behind = (uint16_t)(newest_ - seqno);
+        if (behind >= BATMAN_WINDOW_BITS)
+            return false;
+        return (bits_[behind >> 6] >> (behind & 63)) & 1;
+    }
+
+    /* True if seqno lies in [newest - WINDOW + 1, newest] */
+    bool inRange(uint16_t seqno) const {
+        if (empty_)
+            return false;
+        return (uint16_t)(newest_ - seqno) < BATMAN_WINDOW_BITS;
+    }
+
+    /* Number of sequence numbers received inside the window */
+    int count() const {
+        return __builtin_popcountll(bits_[0]) + __builtin_popcountll(bits_[1]);
+    }
+
+    uint16_t newest() const { return newest_; }
+    bool empty() const { return empty_; }
+
+private:
+    uint64_t bits_[2];   // bits_[0] holds the 64 newest seqnos
+    uint16_t newest_;    // Highest sequence number seen
+    bool empty_;         // Nothing received yet
+
+    void shift(uint16_t n) {
+        if (n >= BATMAN_WINDOW_BITS) {
+            bits_[0] = 0;
+            bits_[1] = 0;
+        } else if (n >= 64) {
+            bits_[1] = bits_[0] << (n - 64);
+            bits_[0] = 0;
+        } else {
+            bits_[1] = (bits_[1] << n) | (bits_[0] >> (64 - n));
+            bits_[0] <<= n;
+        }
+    }
+};
+
+#endif /* __batman_window_h__ */
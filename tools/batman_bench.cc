@@ -0,0 +1,407 @@
+/*
+ * batman_bench.cc
+ * B.A.T.M.A.N. Routing Hot Path Microbenchmarks
+ *
+ * Drives the protocol core's hot paths with synthetic workloads and
+ * prints one JSON object per measurement, so runs can be diffed against
+ * a stored baseline:
+ *
+ *   window      CoreNeighbor::updateWindow, in order with gaps and
+ *               repeats, across seqno wraparound
+ *   ranking     updateNeighborRanking, N originators heard through K
+ *               neighbors each, some OGMs lost, seqnos wrapping
+ *   churn       ranking while 1% of the originators are replaced per
+ *               OGM interval
+ *   duplicate   isDuplicate + logBroadcast, one new and one repeated
+ *               seqno per originator
+ *   lookup      route lookup, half of the destinations unknown
+ *   lookup_hna  longest-prefix lookup over one /24 per originator
+ *   purge       purge() every PURGE_INTERVAL with 1% churn per interval
+ *               and a 10 s purge timeout
+ *
+ * usage: batman_bench [-n originators] [-k neighbors] [-t seconds]
+ *                     [-b bench]
+ *
+ *   -n  comma-separated originator counts (100,1000,10000)
+ *   -k  comma-separated neighbor counts (1,4,16)
+ *   -t  minimum measured seconds per result (0.2)
+ *   -b  run only the named benchmark
+ *
+ * Each line gives ns_per_op and the heap allocations and bytes per op,
+ * counted by replacing the global operator new.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "batman_sim.h"
+
+/* ===== Allocation Counting ===== */
+
+/* GCC pairs the inlined replacements below with malloc/free and warns */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+void* operator new(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+/* ===== Harness ===== */
+
+/* One workload at one size; run() does a batch and returns its op count */
+class Bench {
+public:
+    Bench() : now_(0), rng_(1) {}
+    virtual ~Bench() {}
+    virtual uint64_t run() = 0;
+
+protected:
+    double now_;
+    SimRng rng_;
+};
+
+struct BenchParams {
+    const char *name_;
+    int originators_;
+    int neighbors_;
+};
+
+static double min_time = 0.2;
+
+static void measure(Bench *b, const BenchParams &p) {
+    // One untimed batch to reach steady state
+    b->run();
+
+    uint64_t ops = 0;
+    uint64_t allocs = alloc_count;
+    uint64_t bytes = alloc_bytes;
+    double start = wallTime();
+    double elapsed = 0;
+    while (elapsed < min_time) {
+        ops += b->run();
+        elapsed = wallTime() - start;
+    }
+    allocs = alloc_count - allocs;
+    bytes = alloc_bytes - bytes;
+
+    printf("{\"bench\": \"%s\", \"originators\": %d, \"neighbors\": %d, "
+           "\"ops\": %llu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.4f, "
+           "\"bytes_per_op\": %.2f}\n",
+           p.name_, p.originators_, p.neighbors_, (unsigned long long)ops,
+           elapsed * 1e9 / ops, (double)allocs / ops, (double)bytes / ops);
+    fflush(stdout);
+}
+
+/*
+ * Seqnos start two below the wrap: the untimed batch takes the last one
+ * before it, so the first timed batch of every measurement crosses it,
+ * however few batches a large table leaves time for.
+ */
+#define BENCH_SEQNO_START 65534
+
+/* ===== Workloads ===== */
+
+class WindowBench : public Bench {
+public:
+    WindowBench() : seqno_(BENCH_SEQNO_START) {}
+
+    uint64_t run() {
+        for (int i = 0; i < 4096; i++) {
+            uint64_t r = rng_.next();
+            if ((r & 15) == 0) {
+                // Repeat from inside the window
+                ni_.updateWindow((uint16_t)(seqno_ - (r >> 4) % WINDOW_SIZE));
+                continue;
+            }
+            if ((r & 112) == 0)
+                seqno_++;       // Lost OGM
+            ni_.updateWindow(++seqno_);
+        }
+        return 4096;
+    }
+
+private:
+    CoreNeighbor<SimAddr> ni_;
+    uint16_t seqno_;
+};
+
+/*
+ * Originators are addresses base_ .. base_ + n - 1, neighbors the K
+ * addresses after the largest originator address ever used. Each
+ * interval every originator's new seqno arrives through each neighbor
+ * with 7/8 probability.
+ */
+class RankingBench : public Bench {
+public:
+    RankingBench(int n, int k, double churn) :
+        core_(VirtualClock(&now_)), n_(n), k_(k), base_(1),
+        churn_((int)(n * churn)), seqno_(BENCH_SEQNO_START) {
+        core_.setAddress(0x7fffffff);
+    }
+
+    uint64_t run() {
+        now_ += ORIGINATOR_INTERVAL;
+        seqno_++;
+
+        // Departing originators are dropped as the purge would
+        for (int i = 0; i < churn_; i++) {
+            core_.removeOriginator(base_ + i);
+        }
+        base_ += churn_;
+
+        uint64_t ops = 0;
+        SimAddr neighbor0 = 0x10000000;
+        for (int o = 0; o < n_; o++) {
+            for (int k = 0; k < k_; k++) {
+                if ((rng_.next() & 7) == 0)
+                    continue;
+                core_.updateNeighborRanking(base_ + o, neighbor0 + k, seqno_,
+                                            TTL_MAX - 1 - k);
+                ops++;
+            }
+        }
+        return ops;
+    }
+
+protected:
+    SimCore core_;
+    int n_;
+    int k_;
+    SimAddr base_;
+    int churn_;
+    uint16_t seqno_;
+};
+
+class DuplicateBench : public Bench {
+public:
+    DuplicateBench(int n) : core_(VirtualClock(&now_)), n_(n),
+                            seqno_(BENCH_SEQNO_START) {}
+
+    uint64_t run() {
+        now_ += ORIGINATOR_INTERVAL;
+        seqno_++;
+        uint64_t dups = 0;
+        for (int o = 1; o <= n_; o++) {
+            if (!core_.isDuplicate(o, seqno_))
+                core_.logBroadcast(o, seqno_);
+            dups += core_.isDuplicate(o, seqno_);
+        }
+        if (dups != (uint64_t)n_)
+            abort();
+        return 2 * (uint64_t)n_;
+    }
+
+private:
+    SimCore core_;
+    int n_;
+    uint16_t seqno_;
+};
+
+/* Destinations drawn up front so the RNG stays out of the timing */
+class LookupBench : public Bench {
+public:
+    LookupBench(int n, int k, bool hna) : core_(VirtualClock(&now_)),
+                                          hna_(hna) {
+        for (int o = 1; o <= n; o++) {
+            for (int i = 0; i < k; i++) {
+                core_.updateNeighborRanking(o, 0x10000000 + i,
+                                            BENCH_SEQNO_START, TTL_MAX - 1);
+            }
+            if (hna_)
+                core_.addHNA(o, (SimAddr)o << 8, 24);
+        }
+
+        // Half hit, half miss
+        for (int i = 0; i < 4096; i++) {
+            SimAddr o = 1 + rng_.next() % (2 * n);
+            dests_.push_back(hna_ ? (o << 8) | (rng_.next() & 0xff) : o);
+        }
+    }
+
+    uint64_t run() {
+        SimAddr sum = 0;
+        for (size_t i = 0; i < dests_.size(); i++) {
+            sum += hna_ ? core_.lookupHNA(dests_[i]) : core_.lookup(dests_[i]);
+        }
+        sink_ += sum;
+        return dests_.size();
+    }
+
+    static SimAddr sink_;
+
+private:
+    SimCore core_;
+    bool hna_;
+    std::vector<SimAddr> dests_;
+};
+
+SimAddr LookupBench::sink_ = 0;
+
+/* Times only purge(); the ranking that refreshes entries is untimed */
+class PurgeBench : public RankingBench {
+public:
+    PurgeBench(int n, int k) : RankingBench(n, k, 0.01), purge_time_(0) {
+        core_.setPurgeTimeout(10.0);
+    }
+
+    uint64_t run() {
+        // Departing originators are left for the purge to find
+        int churn = churn_;
+        churn_ = 0;
+        base_ += churn;
+        RankingBench::run();
+        churn_ = churn;
+
+        double start = wallTime();
+        core_.purge();
+        purge_time_ += wallTime() - start;
+        return 1;
+    }
+
+    double purge_time_;
+};
+
+/* Like measure(), but counting only the time spent in purge() */
+static void measurePurge(PurgeBench *b, const BenchParams &p) {
+    // Fill the purge timeout's worth of departures first
+    for (int i = 0; i < 12; i++) {
+        b->run();
+    }
+
+    uint64_t ops = 0;
+    b->purge_time_ = 0;
+    double start = wallTime();
+    while (wallTime() - start < min_time || ops < 20) {
+        ops += b->run();
+    }
+
+    printf("{\"bench\": \"%s\", \"originators\": %d, \"neighbors\": %d, "
+           "\"ops\": %llu, \"ns_per_op\": %.2f}\n",
+           p.name_, p.originators_, p.neighbors_, (unsigned long long)ops,
+           b->purge_time_ * 1e9 / ops);
+    fflush(stdout);
+}
+
+/* ===== Driver ===== */
+
+static std::vector<int> parseList(const char *s) {
+    std::vector<int> v;
+    while (*s != '\0') {
+        int n = atoi(s);
+        if (n < 1) {
+            fprintf(stderr, "batman_bench: bad count in list\n");
+            exit(2);
+        }
+        v.push_back(n);
+        s += strcspn(s, ",");
+        if (*s == ',')
+            s++;
+    }
+    return v;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: batman_bench [-n originators] [-k neighbors] "
+                    "[-t seconds] [-b bench]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> origs = parseList("100,1000,10000");
+    std::vector<int> neighbors = parseList("1,4,16");
+    std::string only;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:k:t:b:")) != -1) {
+        switch (c) {
+        case 'n': origs = parseList(optarg); break;
+        case 'k': neighbors = parseList(optarg); break;
+        case 't': min_time = atof(optarg); break;
+        case 'b': only = optarg; break;
+        default: usage();
+        }
+    }
+    if (min_time <= 0)
+        usage();
+
+#define WANT(name) (only.empty() || only == name)
+
+    if (WANT("window")) {
+        BenchParams p = { "window", 1, 1 };
+        WindowBench b;
+        measure(&b, p);
+    }
+
+    for (size_t i = 0; i < origs.size(); i++) {
+        int n = origs[i];
+        for (size_t j = 0; j < neighbors.size(); j++) {
+            int k = neighbors[j];
+            if (WANT("ranking")) {
+                BenchParams p = { "ranking", n, k };
+                RankingBench b(n, k, 0);
+                measure(&b, p);
+            }
+            if (WANT("churn")) {
+                BenchParams p = { "churn", n, k };
+                RankingBench b(n, k, 0.01);
+                measure(&b, p);
+            }
+            if (WANT("purge")) {
+                BenchParams p = { "purge", n, k };
+                PurgeBench b(n, k);
+                measurePurge(&b, p);
+            }
+        }
+
+        if (WANT("duplicate")) {
+            BenchParams p = { "duplicate", n, 0 };
+            DuplicateBench b(n);
+            measure(&b, p);
+        }
+        if (WANT("lookup")) {
+            BenchParams p = { "lookup", n, 1 };
+            LookupBench b(n, 1, false);
+            measure(&b, p);
+        }
+        if (WANT("lookup_hna")) {
+            BenchParams p = { "lookup_hna", n, 1 };
+            LookupBench b(n, 1, true);
+            measure(&b, p);
+        }
+    }
+    return 0;
+}
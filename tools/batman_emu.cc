@@ -0,0 +1,922 @@
+/*
+ * batman_emu.cc
+ * B.A.T.M.A.N. In-Process Mesh Emulator
+ *
+ * Runs one protocol core (batman_core.h) per node against a simple
+ * channel, with no PHY or MAC model: an OGM broadcast reaches every node
+ * within radio range after a fixed link delay, each delivery lost with a
+ * given probability, or follows a loss matrix read from a file. Nodes
+ * may move by random waypoint. Meant for scaling runs of thousands of
+ * nodes; reports convergence, event and OGM rates and memory per node
+ * as one JSON object on stdout.
+ *
+ * usage: batman_emu [-n nodes] [-t seconds] [-d degree] [-r range]
+ *                   [-l loss] [-m matrix] [-v speed] [-T ttl]
+ *                   [-f radius,stride] [-b staleness] [-A max]
+ *                   [-D delay] [-s seed] [-o trace] [-j threads]
+ *
+ *   -n  number of nodes (1000)
+ *   -t  simulated seconds (60)
+ *   -d  mean neighbors per node; sets the square area's side (8)
+ *   -r  radio range in metres (100)
+ *   -l  per-delivery loss probability on the unit disk (0)
+ *   -m  loss matrix file of "from to delivery_ratio" lines, nodes
+ *       numbered from 1; replaces the unit disk and -n
+ *   -v  random waypoint speed in m/s, 0 for a static mesh (0)
+ *   -T  OGM TTL (TTL_MAX)
+ *   -f  fisheye radius and maximum stride
+ *   -b  batched route publishing staleness in seconds (0, off)
+ *   -A  adaptive OGM interval: stretch up to max seconds while the
+ *       local topology is stable (0, fixed interval)
+ *   -D  link delay in seconds (0.001)
+ *   -s  random seed (1)
+ *   -o  write every OGM reception to a file as an "O" record for
+ *       batman_replay
+ *   -j  worker threads (1)
+ *
+ * Every OGM is flooded up to its TTL, so control traffic grows with the
+ * square of the mesh size; large meshes want -T or -f.
+ * Convergence is judged against where OGMs actually go: relays only
+ * pass on an originator's OGMs heard from their best next hop towards
+ * it, so with a TTL or fisheye some nodes within TTL hops never hear
+ * an originator. ttl_coverage reports the share of those within TTL
+ * hops that have a route anyway.
+ *
+ * With -j, nodes are split into spatial strips (address ranges for a
+ * loss matrix), one per thread, and run as a conservative parallel
+ * simulation: nodes only affect each other through OGM deliveries, which
+ * arrive one link delay after they are sent, so every thread can run
+ * its strip through a window one link delay long before the deliveries
+ * between strips are exchanged. Mobility ticks run between windows.
+ * Events are ordered by (time, node, src, seq) and every node draws from
+ * its own generators, so a run with any thread count gives the same
+ * result as the serial one; route_hash in the report makes that easy to
+ * check.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "batman_adaptive.h"
+#include "batman_sim.h"
+
+/* Mobility and convergence are evaluated once per tick */
+#define EMU_TICK 1.0
+
+struct EmuConfig {
+    int nodes_;
+    double duration_;
+    double degree_;
+    double range_;
+    double loss_;
+    const char *matrix_;
+    double speed_;
+    int ttl_;
+    int fisheye_radius_;
+    int fisheye_stride_;
+    double staleness_;
+    double max_interval_;
+    double delay_;
+    uint64_t seed_;
+    const char *trace_;
+    int threads_;
+
+    EmuConfig() :
+        nodes_(1000), duration_(60), degree_(8), range_(100), loss_(0),
+        matrix_(NULL), speed_(0), ttl_(TTL_MAX), fisheye_radius_(0),
+        fisheye_stride_(1), staleness_(0), max_interval_(0), delay_(0.001),
+        seed_(1),
+        trace_(NULL), threads_(1) {}
+};
+
+class Emulator;
+
+/* One emulated node: its core and what the channel needs to know */
+class EmuNode : public CoreEvents<SimAddr> {
+public:
+    EmuNode(Emulator *emu, SimAddr addr) :
+        now_(0), core_(VirtualClock(&now_), this), emu_(emu), addr_(addr),
+        part_(0), seqno_(0), next_seq_(0),
+        interval_(ORIGINATOR_INTERVAL, ORIGINATOR_INTERVAL),
+        seen_changes_(0), next_ogm_(0), ogm_sent_(0), x_(0), y_(0),
+        dest_x_(0), dest_y_(0), route_changes_(0), last_change_(0) {}
+
+    double now_;                // Time of the event being handled here
+    SimCore core_;
+    Emulator *emu_;
+    SimAddr addr_;
+    int part_;                  // Partition that runs this node
+    SimRng rng_;                // Jitter, forwarding delay, channel loss
+    SimRng mob_rng_;            // Waypoints
+    uint16_t seqno_;
+    uint64_t next_seq_;         // Events this node has scheduled
+
+    AdaptiveInterval interval_;
+    uint32_t seen_changes_;     // core_.topologyChanges() at the last OGM
+    double next_ogm_;           // Due OGM timer; earlier ones are stale
+    uint64_t ogm_sent_;         // Own OGMs originated
+
+    double x_, y_;              // Position on the unit disk
+    double dest_x_, dest_y_;    // Random waypoint target
+
+    uint32_t route_changes_;
+    double last_change_;
+
+    void routeChanged(const SimAddr &, const SimAddr &, const SimAddr &, int) {
+        route_changes_++;
+        last_change_ = core_.clock().now();
+    }
+    void scheduleRecompute(double delay);
+    void topologyChanged();
+    void scheduleOGM(double when);
+};
+
+/* The nodes one thread runs, with their pending events */
+struct EmuPartition {
+    SimEventQueue queue_;
+    std::vector<std::vector<SimEvent> > outbox_;    // Per destination
+    uint64_t events_;
+    uint64_t ogm_tx_;
+    uint64_t ogm_rx_;
+
+    EmuPartition(int parts) :
+        outbox_(parts), events_(0), ogm_tx_(0), ogm_rx_(0) {}
+};
+
+/* Reusable barrier; waiters yield, so threads may outnumber cores */
+class SpinBarrier {
+public:
+    explicit SpinBarrier(int n) : n_(n), waiting_(0), generation_(0) {}
+
+    void wait() {
+        unsigned gen = generation_.load(std::memory_order_acquire);
+        if (waiting_.fetch_add(1, std::memory_order_acq_rel) + 1 == n_) {
+            waiting_.store(0, std::memory_order_relaxed);
+            generation_.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (generation_.load(std::memory_order_acquire) == gen)
+            std::this_thread::yield();
+    }
+
+private:
+    int n_;
+    std::atomic<int> waiting_;
+    std::atomic<unsigned> generation_;
+};
+
+class Emulator {
+public:
+    Emulator(const EmuConfig &cfg);
+    ~Emulator();
+
+    bool setup();
+    void run();
+    void report();
+
+    void schedule(EmuNode *from, SimAddr to, double when, SimEventType type,
+                  const CoreOgm<SimAddr> *ogm = NULL);
+
+private:
+    EmuConfig cfg_;
+    double now_;                    // Time of the last tick
+    std::vector<EmuNode*> nodes_;   // Node with address a at a - 1
+    std::vector<EmuPartition*> parts_;
+
+    /* Parallel runs: the window every partition runs next */
+    SpinBarrier barrier_;
+    double next_tick_;
+    double window_end_;
+    bool window_final_;         // Window ends at the duration, inclusive
+    bool stop_;
+    uint64_t windows_;
+
+    /* Unit disk: nodes bucketed into range-sized grid cells */
+    double side_;
+    int cells_;
+    std::vector<std::vector<SimAddr> > grid_;
+    std::vector<std::vector<SimAddr> > in_range_;   // Per node, from grid_
+
+    /* Loss matrix: (receiver, delivery ratio) per sender */
+    std::vector<std::vector<std::pair<SimAddr, double> > > links_;
+
+    /* Converged: every node that OGMs reach routes back to their origin */
+    double converged_at_;       // -1 until then
+    double mean_degree_;
+
+    double wall_time_;
+    size_t rss_before_;
+    size_t rss_after_;
+
+    FILE *trace_;               // Reception records, or NULL
+
+    bool loadMatrix();
+    void runSerial();
+    void runParallel();
+    void work(int p);
+    void advance();
+    void partition();
+    void handle(EmuPartition *part, const SimEvent &ev);
+    void originate(EmuNode *n);
+    void broadcast(EmuNode *n, const CoreOgm<SimAddr> &ogm);
+    void tick();
+    void move(EmuNode *n, double dt);
+    void buildGrid();
+    void findNeighbors(SimAddr addr, std::vector<SimAddr> &out);
+    void measureDegree();
+    void checkRoutes(bool by_relays, uint64_t &expected, uint64_t &held);
+    uint64_t countRoutes();
+    uint64_t routeHash();
+
+    EmuNode* node(SimAddr addr) { return nodes_[addr - 1]; }
+};
+
+void EmuNode::scheduleRecompute(double delay) {
+    emu_->schedule(this, addr_, now_ + delay, SIM_RECOMPUTE);
+}
+
+void EmuNode::scheduleOGM(double when) {
+    next_ogm_ = when;
+    emu_->schedule(this, addr_, when, SIM_OGM_TIMER);
+}
+
+/* Bring a stretched OGM forward to the fast rate, as the agents do */
+void EmuNode::topologyChanged() {
+    if (!interval_.snapBack())
+        return;
+    double when = now_ + interval_.current() +
+                  rng_.uniform(ORIGINATOR_INTERVAL_JITTER) -
+                  ORIGINATOR_INTERVAL_JITTER / 2;
+    if (when < next_ogm_)
+        scheduleOGM(when);
+}
+
+Emulator::Emulator(const EmuConfig &cfg) :
+    cfg_(cfg), now_(0), barrier_(cfg.threads_), next_tick_(EMU_TICK),
+    window_end_(0), window_final_(false), stop_(false), windows_(0),
+    side_(0), cells_(1), converged_at_(-1),
+    mean_degree_(0), wall_time_(0), rss_before_(0), rss_after_(0),
+    trace_(NULL) {}
+
+Emulator::~Emulator() {
+    if (trace_ != NULL)
+        fclose(trace_);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        delete nodes_[i];
+    }
+    for (size_t i = 0; i < parts_.size(); i++) {
+        delete parts_[i];
+    }
+}
+
+bool Emulator::loadMatrix() {
+    FILE *f = fopen(cfg_.matrix_, "r");
+    if (f == NULL) {
+        fprintf(stderr, "batman_emu: cannot open %s\n", cfg_.matrix_);
+        return false;
+    }
+
+    unsigned long from, to;
+    double ratio;
+    int line = 0;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        line++;
+        if (buf[0] == '#' || buf[strspn(buf, " \t\r\n")] == '\0')
+            continue;
+        if (sscanf(buf, "%lu %lu %lf", &from, &to, &ratio) != 3 ||
+            from == 0 || to == 0 || from == to || ratio < 0 || ratio > 1) {
+            fprintf(stderr, "batman_emu: %s:%d: bad link\n", cfg_.matrix_, line);
+            fclose(f);
+            return false;
+        }
+        size_t n = std::max(from, to);
+        if (links_.size() < n)
+            links_.resize(n);
+        if (ratio > 0)
+            links_[from - 1].push_back(std::make_pair((SimAddr)to, ratio));
+    }
+    fclose(f);
+
+    cfg_.nodes_ = (int)links_.size();
+    return true;
+}
+
+bool Emulator::setup() {
+    if (cfg_.matrix_ != NULL && !loadMatrix())
+        return false;
+    if (cfg_.trace_ != NULL && (trace_ = fopen(cfg_.trace_, "w")) == NULL) {
+        fprintf(stderr, "batman_emu: cannot create %s\n", cfg_.trace_);
+        return false;
+    }
+
+    rss_before_ = residentBytes();
+
+    for (int i = 0; i < cfg_.nodes_; i++) {
+        EmuNode *n = new EmuNode(this, (SimAddr)(i + 1));
+        n->rng_.seed(cfg_.seed_, 2 * n->addr_);
+        n->mob_rng_.seed(cfg_.seed_, 2 * n->addr_ + 1);
+        n->core_.setAddress(n->addr_);
+        n->core_.setTtl((uint8_t)cfg_.ttl_);
+        if (cfg_.fisheye_radius_ > 0)
+            n->core_.fisheye().configure(cfg_.fisheye_radius_,
+                                         cfg_.fisheye_stride_);
+        if (cfg_.staleness_ > 0)
+            n->core_.setBatchRecompute(cfg_.staleness_);
+        nodes_.push_back(n);
+    }
+
+    if (cfg_.matrix_ == NULL) {
+        // Area for the requested mean degree: N * pi * r^2 / side^2 = d
+        side_ = sqrt(cfg_.nodes_ * M_PI * cfg_.range_ * cfg_.range_ /
+                     cfg_.degree_);
+        cells_ = std::max(1, (int)(side_ / cfg_.range_));
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            EmuNode *n = nodes_[i];
+            n->x_ = n->dest_x_ = n->mob_rng_.uniform(side_);
+            n->y_ = n->dest_y_ = n->mob_rng_.uniform(side_);
+        }
+        buildGrid();
+    }
+    measureDegree();
+
+    for (int p = 0; p < cfg_.threads_; p++) {
+        parts_.push_back(new EmuPartition(cfg_.threads_));
+    }
+    partition();
+
+    // Stagger the first OGM and purge of every node
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        EmuNode *n = nodes_[i];
+        if (cfg_.max_interval_ > 0)
+            n->interval_.setBounds(ORIGINATOR_INTERVAL, cfg_.max_interval_);
+        n->scheduleOGM(n->rng_.uniform(ORIGINATOR_INTERVAL));
+        schedule(n, n->addr_, n->rng_.uniform(PURGE_INTERVAL), SIM_PURGE);
+    }
+    return true;
+}
+
+void Emulator::schedule(EmuNode *from, SimAddr to, double when,
+                        SimEventType type, const CoreOgm<SimAddr> *ogm) {
+    SimEvent ev;
+    ev.time_ = when;
+    ev.node_ = to;
+    ev.src_ = from->addr_;
+    ev.seq_ = from->next_seq_++;
+    ev.type_ = type;
+    if (ogm != NULL)
+        ev.ogm_ = *ogm;
+
+    // Deliveries to other strips wait for the end of the window
+    EmuPartition *part = parts_[from->part_];
+    int to_part = node(to)->part_;
+    if (to_part == from->part_)
+        part->queue_.push(ev);
+    else
+        part->outbox_[to_part].push_back(ev);
+}
+
+void Emulator::run() {
+    double start = wallTime();
+    if (parts_.size() > 1)
+        runParallel();
+    else
+        runSerial();
+    now_ = cfg_.duration_;
+
+    wall_time_ = wallTime() - start;
+    rss_after_ = residentBytes();
+}
+
+void Emulator::runSerial() {
+    EmuPartition *part = parts_[0];
+    SimEventQueue &queue = part->queue_;
+
+    while (!queue.empty()) {
+        double when = queue.top().time_;
+        if (next_tick_ <= cfg_.duration_ && when >= next_tick_) {
+            now_ = next_tick_;
+            tick();
+            next_tick_ += EMU_TICK;
+            continue;
+        }
+        if (when > cfg_.duration_)
+            break;
+
+        SimEvent ev = queue.top();
+        queue.pop();
+        handle(part, ev);
+    }
+}
+
+void Emulator::runParallel() {
+    std::vector<std::thread> threads;
+    for (size_t p = 1; p < parts_.size(); p++) {
+        threads.push_back(std::thread(&Emulator::work, this, (int)p));
+    }
+    work(0);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/*
+ * One thread's loop. Thread 0 picks each window while the others wait;
+ * then all run their strips through it, and finally each takes the
+ * deliveries the others addressed to it.
+ */
+void Emulator::work(int p) {
+    EmuPartition *part = parts_[p];
+    SimEventQueue &queue = part->queue_;
+
+    for (;;) {
+        if (p == 0)
+            advance();
+        barrier_.wait();
+        if (stop_)
+            return;
+
+        while (!queue.empty()) {
+            double when = queue.top().time_;
+            if (window_final_ ? when > window_end_ : when >= window_end_)
+                break;
+            SimEvent ev = queue.top();
+            queue.pop();
+            handle(part, ev);
+        }
+        barrier_.wait();
+
+        for (size_t q = 0; q < parts_.size(); q++) {
+            std::vector<SimEvent> &in = parts_[q]->outbox_[p];
+            for (size_t i = 0; i < in.size(); i++) {
+                queue.push(in[i]);
+            }
+            in.clear();
+        }
+        barrier_.wait();
+    }
+}
+
+/*
+ * Runs due ticks and picks the next window, from the earliest pending
+ * event up to one link delay later: an event inside the window can only
+ * reach another node at or after its end. The forwarding delay does not
+ * widen the window, since own OGMs go out without one and it may be
+ * near zero.
+ */
+void Emulator::advance() {
+    for (;;) {
+        double next = std::numeric_limits<double>::infinity();
+        for (size_t p = 0; p < parts_.size(); p++) {
+            if (!parts_[p]->queue_.empty())
+                next = std::min(next, parts_[p]->queue_.top().time_);
+        }
+        if (next == std::numeric_limits<double>::infinity()) {
+            stop_ = true;
+            return;
+        }
+
+        if (next_tick_ <= cfg_.duration_ && next >= next_tick_) {
+            now_ = next_tick_;
+            tick();
+            next_tick_ += EMU_TICK;
+            continue;
+        }
+        if (next > cfg_.duration_) {
+            stop_ = true;
+            return;
+        }
+
+        window_end_ = next + cfg_.delay_;
+        if (next_tick_ <= cfg_.duration_)
+            window_end_ = std::min(window_end_, next_tick_);
+        window_final_ = window_end_ > cfg_.duration_;
+        if (window_final_)
+            window_end_ = cfg_.duration_;
+        windows_++;
+        return;
+    }
+}
+
+/*
+ * Strips of equal node count across the area's x axis, or address
+ * ranges for a loss matrix. With mobility, nodes are reassigned at every
+ * tick and their pending events follow them.
+ */
+void Emulator::partition() {
+    size_t parts = parts_.size();
+    if (parts == 1)
+        return;
+
+    std::vector<std::pair<double, SimAddr> > order;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        EmuNode *n = nodes_[i];
+        order.push_back(std::make_pair(cfg_.matrix_ != NULL ? 0 : n->x_,
+                                       n->addr_));
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++) {
+        node(order[i].second)->part_ = (int)(i * parts / order.size());
+    }
+
+    std::vector<SimEvent> pending;
+    for (size_t p = 0; p < parts; p++) {
+        SimEventQueue &queue = parts_[p]->queue_;
+        while (!queue.empty()) {
+            pending.push_back(queue.top());
+            queue.pop();
+        }
+    }
+    for (size_t i = 0; i < pending.size(); i++) {
+        parts_[node(pending[i].node_)->part_]->queue_.push(pending[i]);
+    }
+}
+
+void Emulator::handle(EmuPartition *part, const SimEvent &ev) {
+    EmuNode *n = node(ev.node_);
+    double now = n->now_ = ev.time_;
+    part->events_++;
+
+    switch (ev.type_) {
+    case SIM_OGM_TIMER: {
+        if (ev.time_ != n->next_ogm_)
+            break;          // Superseded by an earlier one
+        originate(n);
+
+        // Stable since the last OGM if the core reported nothing
+        uint32_t changes = n->core_.topologyChanges();
+        double interval = n->interval_.next(changes != n->seen_changes_);
+        n->seen_changes_ = changes;
+        double jitter = n->rng_.uniform(ORIGINATOR_INTERVAL_JITTER) -
+                        ORIGINATOR_INTERVAL_JITTER / 2;
+        n->scheduleOGM(now + interval + jitter);
+        break;
+    }
+
+    case SIM_TRANSMIT:
+        broadcast(n, ev.ogm_);
+        break;
+
+    case SIM_RECEIVE: {
+        part->ogm_rx_++;
+        if (trace_ != NULL) {
+            const CoreOgm<SimAddr> &o = ev.ogm_;
+            fprintf(trace_, "O %.9f %u %u %u %u %u %u %u %u\n", now,
+                    n->addr_, o.sender_, o.orig_, o.seqno_, o.ttl_, o.flags_,
+                    o.gw_flags_, o.gw_port_);
+        }
+        int verdict = n->core_.receiveOGM(ev.ogm_);
+        if (!(verdict & OGM_FORWARD) || ev.ogm_.ttl_ <= 1)
+            break;
+
+        // Relay after a random delay, as the agents do
+        CoreOgm<SimAddr> fwd = ev.ogm_;
+        fwd.ttl_--;
+        if (fwd.sender_ == fwd.orig_)
+            fwd.flags_ |= BATMAN_FLAG_DIRECTLINK;
+        else
+            fwd.flags_ &= ~BATMAN_FLAG_DIRECTLINK;
+        fwd.sender_ = n->addr_;
+        schedule(n, n->addr_, now + n->rng_.uniform(BROADCAST_DELAY_MAX),
+                 SIM_TRANSMIT, &fwd);
+        break;
+    }
+
+    case SIM_PURGE:
+        n->core_.purge();
+        schedule(n, n->addr_, now + PURGE_INTERVAL, SIM_PURGE);
+        break;
+
+    case SIM_RECOMPUTE:
+        n->core_.recompute();
+        break;
+    }
+}
+
+void Emulator::originate(EmuNode *n) {
+    CoreOgm<SimAddr> ogm;
+    ogm.sender_ = n->addr_;
+    ogm.orig_ = n->addr_;
+    ogm.seqno_ = ++n->seqno_;
+    ogm.ttl_ = (uint8_t)cfg_.ttl_;
+    n->ogm_sent_++;
+    broadcast(n, ogm);
+}
+
+void Emulator::broadcast(EmuNode *n, const CoreOgm<SimAddr> &ogm) {
+    parts_[n->part_]->ogm_tx_++;
+    double when = n->now_ + cfg_.delay_;
+
+    if (cfg_.matrix_ != NULL) {
+        const std::vector<std::pair<SimAddr, double> > &out = links_[n->addr_ - 1];
+        for (size_t i = 0; i < out.size(); i++) {
+            if (out[i].second >= 1.0 || n->rng_.uniform() < out[i].second)
+                schedule(n, out[i].first, when, SIM_RECEIVE, &ogm);
+        }
+        return;
+    }
+
+    const std::vector<SimAddr> &in_range = in_range_[n->addr_ - 1];
+    for (size_t i = 0; i < in_range.size(); i++) {
+        if (cfg_.loss_ <= 0 || n->rng_.uniform() >= cfg_.loss_)
+            schedule(n, in_range[i], when, SIM_RECEIVE, &ogm);
+    }
+}
+
+void Emulator::tick() {
+    if (cfg_.matrix_ == NULL && cfg_.speed_ > 0) {
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            move(nodes_[i], EMU_TICK);
+        }
+        buildGrid();
+        measureDegree();
+        partition();
+    }
+
+    if (converged_at_ < 0) {
+        uint64_t expected, held;
+        checkRoutes(true, expected, held);
+        if (held == expected)
+            converged_at_ = now_;
+    }
+}
+
+void Emulator::move(EmuNode *n, double dt) {
+    double step = cfg_.speed_ * dt;
+    while (step > 0) {
+        double dx = n->dest_x_ - n->x_;
+        double dy = n->dest_y_ - n->y_;
+        double dist = sqrt(dx * dx + dy * dy);
+        if (dist > step) {
+            n->x_ += dx * step / dist;
+            n->y_ += dy * step / dist;
+            return;
+        }
+        // Reached the waypoint; head for the next one
+        n->x_ = n->dest_x_;
+        n->y_ = n->dest_y_;
+        step -= dist;
+        n->dest_x_ = n->mob_rng_.uniform(side_);
+        n->dest_y_ = n->mob_rng_.uniform(side_);
+    }
+}
+
+void Emulator::buildGrid() {
+    grid_.assign((size_t)cells_ * cells_, std::vector<SimAddr>());
+    double cell = side_ / cells_;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        EmuNode *n = nodes_[i];
+        int cx = std::min(cells_ - 1, (int)(n->x_ / cell));
+        int cy = std::min(cells_ - 1, (int)(n->y_ / cell));
+        grid_[cy * cells_ + cx].push_back(n->addr_);
+    }
+
+    // Positions only change on ticks; broadcasts reuse these lists
+    in_range_.resize(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        in_range_[i].clear();
+        findNeighbors(nodes_[i]->addr_, in_range_[i]);
+    }
+}
+
+void Emulator::findNeighbors(SimAddr addr, std::vector<SimAddr> &out) {
+    EmuNode *n = node(addr);
+    double cell = side_ / cells_;
+    int cx = std::min(cells_ - 1, (int)(n->x_ / cell));
+    int cy = std::min(cells_ - 1, (int)(n->y_ / cell));
+    double r2 = cfg_.range_ * cfg_.range_;
+
+    // Cells are at least a range wide, so the 3x3 block covers the disk
+    for (int y = std::max(0, cy - 1); y <= std::min(cells_ - 1, cy + 1); y++) {
+        for (int x = std::max(0, cx - 1); x <= std::min(cells_ - 1, cx + 1); x++) {
+            const std::vector<SimAddr> &c = grid_[y * cells_ + x];
+            for (size_t i = 0; i < c.size(); i++) {
+                if (c[i] == addr)
+                    continue;
+                EmuNode *m = node(c[i]);
+                double dx = m->x_ - n->x_;
+                double dy = m->y_ - n->y_;
+                if (dx * dx + dy * dy <= r2)
+                    out.push_back(c[i]);
+            }
+        }
+    }
+}
+
+void Emulator::measureDegree() {
+    size_t n = nodes_.size();
+    uint64_t links = 0;
+    for (size_t i = 0; i < n; i++) {
+        links += (cfg_.matrix_ != NULL) ? links_[i].size() :
+                 in_range_[i].size();
+    }
+    mean_degree_ = n > 0 ? (double)links / n : 0;
+}
+
+/*
+ * Follows every originator's OGMs out to its TTL and counts the nodes
+ * they reach (expected) and how many of those route back to it (held).
+ * by_relays follows the protocol: the originator's neighbors relay it,
+ * and further out a node relays only what its current best next hop
+ * towards the originator sent. Otherwise every node within TTL hops is
+ * counted, as if OGMs took every shortest path.
+ */
+void Emulator::checkRoutes(bool by_relays, uint64_t &expected,
+                           uint64_t &held) {
+    size_t n = nodes_.size();
+    std::vector<SimAddr> seen(n, 0);    // Origin that last reached a node
+    std::vector<SimAddr> relay(n, 0);   // Origin that a node last relayed
+    std::vector<SimAddr> hop(n, 0);     // A reached node's route back
+    std::vector<SimAddr> level, next;
+    expected = held = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        SimAddr orig = nodes_[i]->addr_;
+        seen[i] = relay[i] = orig;
+        level.assign(1, orig);
+        for (int hops = 1; hops <= cfg_.ttl_ && !level.empty(); hops++) {
+            next.clear();
+            for (size_t k = 0; k < level.size(); k++) {
+                size_t from = level[k] - 1;
+                size_t degree = (cfg_.matrix_ != NULL) ? links_[from].size() :
+                                in_range_[from].size();
+                for (size_t j = 0; j < degree; j++) {
+                    SimAddr to = (cfg_.matrix_ != NULL) ?
+                                 links_[from][j].first : in_range_[from][j];
+                    if (seen[to - 1] != orig) {
+                        seen[to - 1] = orig;
+                        hop[to - 1] = node(to)->core_.lookup(orig);
+                        expected++;
+                        if (hop[to - 1] != SimAddr())
+                            held++;
+                    }
+                    if (relay[to - 1] == orig)
+                        continue;
+                    if (by_relays && level[k] != orig &&
+                        hop[to - 1] != level[k])
+                        continue;
+                    relay[to - 1] = orig;
+                    next.push_back(to);
+                }
+            }
+            level.swap(next);
+        }
+    }
+}
+
+uint64_t Emulator::countRoutes() {
+    uint64_t routes = 0;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        routes += nodes_[i]->core_.fib().routes();
+    }
+    return routes;
+}
+
+/* Order-independent digest of every node's routes */
+uint64_t Emulator::routeHash() {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        EmuNode *n = nodes_[i];
+        SimCore::OriginatorTable &table = n->core_.originators();
+        SimCore::OriginatorTable::iterator it;
+        for (it = table.begin(); it != table.end(); ++it) {
+            const CoreOriginator<SimAddr> *oe = it->second;
+            if (!oe->hasRoute())
+                continue;
+            SimRng mix(((uint64_t)n->addr_ << 32) | oe->orig_addr_);
+            mix.seed(mix.next() ^ oe->best_next_hop_, oe->best_route_count_);
+            hash += mix.next();
+        }
+    }
+    return hash;
+}
+
+void Emulator::report() {
+    uint64_t events = 0, ogm_tx = 0, ogm_rx = 0;
+    for (size_t p = 0; p < parts_.size(); p++) {
+        events += parts_[p]->events_;
+        ogm_tx += parts_[p]->ogm_tx_;
+        ogm_rx += parts_[p]->ogm_rx_;
+    }
+
+    double last_change = 0;
+    uint64_t route_changes = 0, ogm_sent = 0;
+    size_t pool_bytes = 0;
+    BatmanStats stats;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        EmuNode *n = nodes_[i];
+        stats.merge(n->core_.stats());
+        last_change = std::max(last_change, n->last_change_);
+        route_changes += n->route_changes_;
+        ogm_sent += n->ogm_sent_;
+        pool_bytes += n->core_.bytesReserved();
+    }
+    double n = std::max((size_t)1, nodes_.size());
+    uint64_t expected, held, scope, scope_held;
+    checkRoutes(true, expected, held);
+    checkRoutes(false, scope, scope_held);
+    size_t rss = rss_after_ > rss_before_ ? rss_after_ - rss_before_ : 0;
+
+    printf("{\n");
+    printf("  \"nodes\": %lu,\n", (unsigned long)nodes_.size());
+    printf("  \"mean_degree\": %.2f,\n", mean_degree_);
+    printf("  \"sim_seconds\": %.3f,\n", cfg_.duration_);
+    printf("  \"threads\": %lu,\n", (unsigned long)parts_.size());
+    printf("  \"windows\": %llu,\n", (unsigned long long)windows_);
+    printf("  \"wall_seconds\": %.3f,\n", wall_time_);
+    printf("  \"events\": %llu,\n", (unsigned long long)events);
+    printf("  \"events_per_sec\": %.0f,\n",
+           wall_time_ > 0 ? events / wall_time_ : 0);
+    printf("  \"ogm_sent\": %llu,\n", (unsigned long long)ogm_sent);
+    printf("  \"ogm_tx\": %llu,\n", (unsigned long long)ogm_tx);
+    printf("  \"ogm_rx\": %llu,\n", (unsigned long long)ogm_rx);
+    printf("  \"ogm_duplicate\": %llu,\n",
+           (unsigned long long)stats.ogm_duplicate_);
+    printf("  \"ogm_unidirectional\": %llu,\n",
+           (unsigned long long)stats.ogm_unidirectional_);
+    printf("  \"ogm_tx_per_sim_sec\": %.0f,\n",
+           cfg_.duration_ > 0 ? ogm_tx / cfg_.duration_ : 0);
+    printf("  \"ogm_rx_per_sec\": %.0f,\n",
+           wall_time_ > 0 ? ogm_rx / wall_time_ : 0);
+    printf("  \"converged_at\": %.3f,\n", converged_at_);
+    printf("  \"last_route_change\": %.3f,\n", last_change);
+    printf("  \"route_changes\": %llu,\n", (unsigned long long)route_changes);
+    printf("  \"route_coverage\": %.4f,\n",
+           expected > 0 ? (double)held / expected : 1.0);
+    printf("  \"ttl_coverage\": %.4f,\n",
+           scope > 0 ? (double)scope_held / scope : 1.0);
+    printf("  \"stale_routes\": %llu,\n",
+           (unsigned long long)(countRoutes() - held));
+    printf("  \"route_hash\": \"%016llx\",\n", (unsigned long long)routeHash());
+    printf("  \"pool_bytes_per_node\": %.0f,\n", pool_bytes / n);
+    printf("  \"rss_bytes_per_node\": %.0f\n", rss / n);
+    printf("}\n");
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: batman_emu [-n nodes] [-t seconds] [-d degree] [-r range]\n"
+            "                  [-l loss] [-m matrix] [-v speed] [-T ttl]\n"
+            "                  [-f radius,stride] [-b staleness] [-A max]\n"
+            "                  [-D delay] [-s seed] [-o trace] [-j threads]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    EmuConfig cfg;
+    int c;
+    while ((c = getopt(argc, argv, "n:t:d:r:l:m:v:T:f:b:A:D:s:o:j:")) != -1) {
+        switch (c) {
+        case 'n': cfg.nodes_ = atoi(optarg); break;
+        case 't': cfg.duration_ = atof(optarg); break;
+        case 'd': cfg.degree_ = atof(optarg); break;
+        case 'r': cfg.range_ = atof(optarg); break;
+        case 'l': cfg.loss_ = atof(optarg); break;
+        case 'm': cfg.matrix_ = optarg; break;
+        case 'v': cfg.speed_ = atof(optarg); break;
+        case 'T': cfg.ttl_ = atoi(optarg); break;
+        case 'f':
+            if (sscanf(optarg, "%d,%d", &cfg.fisheye_radius_,
+                       &cfg.fisheye_stride_) != 2)
+                usage();
+            break;
+        case 'b': cfg.staleness_ = atof(optarg); break;
+        case 'A': cfg.max_interval_ = atof(optarg); break;
+        case 'D': cfg.delay_ = atof(optarg); break;
+        case 's': cfg.seed_ = strtoull(optarg, NULL, 0); break;
+        case 'o': cfg.trace_ = optarg; break;
+        case 'j': cfg.threads_ = atoi(optarg); break;
+        default: usage();
+        }
+    }
+    if (cfg.nodes_ < 1 || cfg.duration_ <= 0 || cfg.degree_ <= 0 ||
+        cfg.range_ <= 0 || cfg.loss_ < 0 || cfg.loss_ >= 1 ||
+        cfg.speed_ < 0 || cfg.ttl_ < TTL_MIN || cfg.ttl_ > TTL_MAX ||
+        cfg.fisheye_radius_ < 0 || cfg.fisheye_stride_ < 1 ||
+        cfg.staleness_ < 0 || cfg.delay_ <= 0 ||
+        (cfg.max_interval_ != 0 && cfg.max_interval_ < ORIGINATOR_INTERVAL) ||
+        cfg.threads_ < 1)
+        usage();
+
+    // Records would interleave in a different order
+    if (cfg.trace_ != NULL && cfg.threads_ > 1) {
+        fprintf(stderr, "batman_emu: -o needs a serial run\n");
+        return 2;
+    }
+
+    Emulator emu(cfg);
+    if (!emu.setup())
+        return 1;
+    emu.run();
+    emu.report();
+    return 0;
+}
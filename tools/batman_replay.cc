@@ -0,0 +1,377 @@
+/*
+ * batman_replay.cc
+ * B.A.T.M.A.N. OGM Trace Replay
+ *
+ * Feeds recorded OGM receptions through the protocol core's receive path
+ * (the logic behind the NS2 agent's recvOGM and the NS3 ProcessOgm) on a
+ * virtual clock, one core per receiving node, and reports the wall-clock
+ * cost of every message as percentiles plus the final routing tables as
+ * one JSON object on stdout. Replaying the same trace before and after a
+ * change gives a reproducible CPU comparison on real traffic.
+ *
+ * usage: batman_replay [-a addr] [-T ttl] [-f radius,stride] [-r runs]
+ *                      [-q] [trace]
+ *
+ *   -a  address of the receiving node for bare tuples (1)
+ *   -T  OGM TTL the originators used (TTL_MAX)
+ *   -f  fisheye radius and maximum stride the mesh ran with
+ *   -r  replay the trace this many times, pooling the samples (1)
+ *   -q  leave the routing tables out of the report
+ *
+ * The trace (stdin if not given) holds one reception per line, either a
+ * bare tuple received by the -a node:
+ *
+ *   time sender originator seqno ttl flags
+ *
+ * or an "O" record as written to the NS2 log target by the agents and
+ * by batman_emu -o, naming the receiving node:
+ *
+ *   O time node sender originator seqno ttl flags [gw_flags gw_port]
+ *
+ * Any other line, such as the rest of an NS2 trace file, is ignored;
+ * reception lines that do not parse are counted as skipped. Addresses
+ * are kept as in the trace, NS2's node 0 included: the cores see every
+ * address plus one, since 0 is their "no address".
+ *
+ * Messages are replayed in time order. Every node's table is purged each
+ * PURGE_INTERVAL of trace time; purges are timed separately.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "batman_sim.h"
+
+struct ReplayConfig {
+    SimAddr addr_;
+    int ttl_;
+    int fisheye_radius_;
+    int fisheye_stride_;
+    int runs_;
+    bool tables_;
+    const char *trace_;
+
+    ReplayConfig() :
+        addr_(1), ttl_(TTL_MAX), fisheye_radius_(0), fisheye_stride_(1),
+        runs_(1), tables_(true), trace_(NULL) {}
+};
+
+/* One recorded reception */
+struct ReplayMessage {
+    double time_;
+    SimAddr node_;
+    CoreOgm<SimAddr> ogm_;
+
+    bool operator<(const ReplayMessage &o) const { return time_ < o.time_; }
+};
+
+/* Latency samples in nanoseconds */
+class Samples {
+public:
+    void add(double ns) { v_.push_back(ns); }
+    size_t size() const { return v_.size(); }
+
+    void print(const char *name, bool last) {
+        std::sort(v_.begin(), v_.end());
+        double sum = 0;
+        for (size_t i = 0; i < v_.size(); i++) {
+            sum += v_[i];
+        }
+        printf("  \"%s\": {\"count\": %lu, \"mean\": %.1f, \"p50\": %.1f, "
+               "\"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, "
+               "\"max\": %.1f}%s\n",
+               name, (unsigned long)v_.size(),
+               v_.empty() ? 0.0 : sum / v_.size(), at(0.5), at(0.9),
+               at(0.99), at(0.999), v_.empty() ? 0.0 : v_.back(),
+               last ? "" : ",");
+    }
+
+private:
+    std::vector<double> v_;
+
+    /* Nearest-rank percentile of the sorted samples */
+    double at(double q) const {
+        if (v_.empty())
+            return 0;
+        size_t i = (size_t)(q * v_.size());
+        return v_[std::min(i, v_.size() - 1)];
+    }
+};
+
+class Replay {
+public:
+    Replay(const ReplayConfig &cfg);
+    ~Replay();
+
+    bool load();
+    void run();
+    void report();
+
+private:
+    ReplayConfig cfg_;
+    double now_;
+    std::vector<ReplayMessage> trace_;
+    std::map<SimAddr, SimCore*> cores_;
+
+    Samples recv_ns_;
+    Samples purge_ns_;
+    double timer_ns_;           // Cost of one timestamp pair
+
+    /* Verdicts, last run */
+    uint64_t accepted_;
+    uint64_t forwarded_;
+    uint64_t dropped_;
+    double wall_time_;
+    uint64_t skipped_;          // Reception lines that did not parse
+
+    int parse(const char *line, ReplayMessage &m);
+    SimCore* core(SimAddr addr);
+    void reset();
+    void purgeAll();
+};
+
+Replay::Replay(const ReplayConfig &cfg) :
+    cfg_(cfg), now_(0), timer_ns_(0), accepted_(0), forwarded_(0),
+    dropped_(0), wall_time_(0), skipped_(0) {}
+
+Replay::~Replay() {
+    reset();
+}
+
+/* Trace addresses start at 0 in NS2; the cores reserve 0 */
+static inline SimAddr coreAddr(SimAddr a) { return a + 1; }
+static inline SimAddr traceAddr(SimAddr a) { return a - 1; }
+
+/* 1 for a reception, 0 for a line that is not one, -1 if malformed */
+int Replay::parse(const char *line, ReplayMessage &m) {
+    unsigned node, sender, orig, seqno, ttl, flags;
+    unsigned gw_flags = 0, gw_port = 0;
+
+    if (line[0] == 'O' && line[1] == ' ') {
+        int n = sscanf(line + 2, "%lf %u %u %u %u %u %u %u %u", &m.time_,
+                       &node, &sender, &orig, &seqno, &ttl, &flags,
+                       &gw_flags, &gw_port);
+        if (n != 7 && n != 9)
+            return -1;
+    } else if (line[0] >= '0' && line[0] <= '9') {
+        node = cfg_.addr_;
+        if (sscanf(line, "%lf %u %u %u %u %u", &m.time_, &sender, &orig,
+                   &seqno, &ttl, &flags) != 6)
+            return -1;
+    } else {
+        return 0;
+    }
+
+    // The highest address has no room for the shift
+    if (coreAddr(node) == 0 || coreAddr(sender) == 0 ||
+        coreAddr(orig) == 0 || m.time_ < 0)
+        return -1;
+
+    m.node_ = coreAddr(node);
+    m.ogm_.sender_ = coreAddr(sender);
+    m.ogm_.orig_ = coreAddr(orig);
+    m.ogm_.seqno_ = (uint16_t)seqno;
+    m.ogm_.ttl_ = (uint8_t)ttl;
+    m.ogm_.flags_ = (uint8_t)flags;
+    m.ogm_.gw_flags_ = (uint8_t)gw_flags;
+    m.ogm_.gw_port_ = (uint16_t)gw_port;
+    return 1;
+}
+
+bool Replay::load() {
+    FILE *f = stdin;
+    if (cfg_.trace_ != NULL && (f = fopen(cfg_.trace_, "r")) == NULL) {
+        fprintf(stderr, "batman_replay: cannot open %s\n", cfg_.trace_);
+        return false;
+    }
+
+    char line[256];
+    ReplayMessage m;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int r = parse(line, m);
+        if (r > 0)
+            trace_.push_back(m);
+        else if (r < 0)
+            skipped_++;
+    }
+    if (f != stdin)
+        fclose(f);
+
+    if (skipped_ > 0) {
+        fprintf(stderr, "batman_replay: skipped %llu malformed receptions\n",
+                (unsigned long long)skipped_);
+    }
+
+    if (trace_.empty()) {
+        fprintf(stderr, "batman_replay: no OGM receptions in trace\n");
+        return false;
+    }
+
+    // Records from different nodes' log targets may interleave
+    std::stable_sort(trace_.begin(), trace_.end());
+    return true;
+}
+
+SimCore* Replay::core(SimAddr addr) {
+    std::map<SimAddr, SimCore*>::iterator it = cores_.find(addr);
+    if (it != cores_.end())
+        return it->second;
+
+    SimCore *c = new SimCore(VirtualClock(&now_));
+    c->setAddress(addr);
+    c->setTtl((uint8_t)cfg_.ttl_);
+    if (cfg_.fisheye_radius_ > 0)
+        c->fisheye().configure(cfg_.fisheye_radius_, cfg_.fisheye_stride_);
+    cores_[addr] = c;
+    return c;
+}
+
+void Replay::reset() {
+    std::map<SimAddr, SimCore*>::iterator it;
+    for (it = cores_.begin(); it != cores_.end(); ++it) {
+        delete it->second;
+    }
+    cores_.clear();
+}
+
+void Replay::purgeAll() {
+    std::map<SimAddr, SimCore*>::iterator it;
+    for (it = cores_.begin(); it != cores_.end(); ++it) {
+        double start = wallTime();
+        it->second->purge();
+        purge_ns_.add((wallTime() - start) * 1e9);
+    }
+}
+
+void Replay::run() {
+    // Back-to-back timestamps, taken off nothing but reported alongside
+    double start = wallTime();
+    for (int i = 0; i < 1000; i++) {
+        wallTime();
+    }
+    timer_ns_ = (wallTime() - start) * 1e9 / 1000;
+
+    start = wallTime();
+    for (int r = 0; r < cfg_.runs_; r++) {
+        reset();
+        accepted_ = forwarded_ = dropped_ = 0;
+        double next_purge = trace_[0].time_ + PURGE_INTERVAL;
+
+        for (size_t i = 0; i < trace_.size(); i++) {
+            const ReplayMessage &m = trace_[i];
+            while (next_purge <= m.time_) {
+                now_ = next_purge;
+                purgeAll();
+                next_purge += PURGE_INTERVAL;
+            }
+            now_ = m.time_;
+
+            // Node lookup stays outside the timed region
+            SimCore *c = core(m.node_);
+            double t0 = wallTime();
+            int verdict = c->receiveOGM(m.ogm_);
+            recv_ns_.add((wallTime() - t0) * 1e9);
+
+            if (verdict & OGM_ACCEPTED)
+                accepted_++;
+            else
+                dropped_++;
+            if (verdict & OGM_FORWARD)
+                forwarded_++;
+        }
+    }
+    wall_time_ = wallTime() - start;
+}
+
+void Replay::report() {
+    printf("{\n");
+    printf("  \"messages\": %lu,\n", (unsigned long)trace_.size());
+    printf("  \"skipped\": %llu,\n", (unsigned long long)skipped_);
+    printf("  \"nodes\": %lu,\n", (unsigned long)cores_.size());
+    printf("  \"trace_seconds\": %.3f,\n",
+           trace_.back().time_ - trace_.front().time_);
+    printf("  \"runs\": %d,\n", cfg_.runs_);
+    printf("  \"wall_seconds\": %.3f,\n", wall_time_);
+    printf("  \"accepted\": %llu,\n", (unsigned long long)accepted_);
+    printf("  \"forwarded\": %llu,\n", (unsigned long long)forwarded_);
+    printf("  \"dropped\": %llu,\n", (unsigned long long)dropped_);
+    printf("  \"timer_ns\": %.1f,\n", timer_ns_);
+    recv_ns_.print("recv_ns", false);
+    purge_ns_.print("purge_ns", !cfg_.tables_);
+
+    if (!cfg_.tables_) {
+        printf("}\n");
+        return;
+    }
+
+    // Routes as [destination, next hop, packet count], by destination
+    printf("  \"tables\": {");
+    std::map<SimAddr, SimCore*>::iterator it;
+    for (it = cores_.begin(); it != cores_.end(); ++it) {
+        std::map<SimAddr, const CoreOriginator<SimAddr>*> sorted;
+        SimCore::OriginatorTable &table = it->second->originators();
+        SimCore::OriginatorTable::iterator ot;
+        for (ot = table.begin(); ot != table.end(); ++ot) {
+            if (ot->second->hasRoute())
+                sorted[ot->first] = ot->second;
+        }
+
+        printf("%s\n    \"%u\": [", it == cores_.begin() ? "" : ",",
+               (unsigned)traceAddr(it->first));
+        std::map<SimAddr, const CoreOriginator<SimAddr>*>::iterator st;
+        for (st = sorted.begin(); st != sorted.end(); ++st) {
+            printf("%s[%u, %u, %d]", st == sorted.begin() ? "" : ", ",
+                   (unsigned)traceAddr(st->first),
+                   (unsigned)traceAddr(st->second->best_next_hop_),
+                   st->second->best_route_count_);
+        }
+        printf("]");
+    }
+    printf("\n  }\n");
+    printf("}\n");
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: batman_replay [-a addr] [-T ttl] [-f radius,stride] "
+            "[-r runs]\n"
+            "                     [-q] [trace]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    ReplayConfig cfg;
+    int c;
+    while ((c = getopt(argc, argv, "a:T:f:r:q")) != -1) {
+        switch (c) {
+        case 'a': cfg.addr_ = (SimAddr)strtoul(optarg, NULL, 0); break;
+        case 'T': cfg.ttl_ = atoi(optarg); break;
+        case 'f':
+            if (sscanf(optarg, "%d,%d", &cfg.fisheye_radius_,
+                       &cfg.fisheye_stride_) != 2)
+                usage();
+            break;
+        case 'r': cfg.runs_ = atoi(optarg); break;
+        case 'q': cfg.tables_ = false; break;
+        default: usage();
+        }
+    }
+    if (optind < argc)
+        cfg.trace_ = argv[optind++];
+    if (optind < argc || cfg.ttl_ < TTL_MIN ||
+        cfg.ttl_ > TTL_MAX || cfg.fisheye_radius_ < 0 ||
+        cfg.fisheye_stride_ < 1 || cfg.runs_ < 1)
+        usage();
+
+    Replay replay(cfg);
+    if (!replay.load())
+        return 1;
+    replay.run();
+    replay.report();
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * batman_sim.h
+ * B.A.T.M.A.N. Standalone Simulation Support
+ *
+ * Virtual clock, deterministic random numbers and an event queue for
+ * running the protocol core (batman_core.h) outside NS2 and NS3. Used
+ * by the tools in this directory; depends only on the C++ library.
+ */
+
+#ifndef __batman_sim_h__
+#define __batman_sim_h__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <chrono>
+#include <queue>
+#include <vector>
+
+#include "batman_core.h"
+
+/* Node addresses are 1..N; 0 is the core's "no address" */
+typedef uint32_t SimAddr;
+
+/* Clock read by a core; the owner advances *now_ */
+struct VirtualClock {
+    const double *now_;
+
+    VirtualClock(const double *now = NULL) : now_(now) {}
+    double now() const { return *now_; }
+};
+
+typedef BatmanCore<SimAddr, VirtualClock> SimCore;
+
+/*
+ * splitmix64. Each node owns a generator seeded from the run seed and
+ * its address, so its draws do not depend on how other nodes' events
+ * interleave with its own.
+ */
+class SimRng {
+public:
+    explicit SimRng(uint64_t seed = 0) : state_(seed) {}
+
+    void seed(uint64_t seed, uint64_t stream) {
+        state_ = seed ^ (stream * 0xd1342543de82ef95ull);
+        next();
+    }
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    /* Uniform in [0, max) */
+    double uniform(double max = 1.0) {
+        return (double)(next() >> 11) * (1.0 / 9007199254740992.0) * max;
+    }
+
+private:
+    uint64_t state_;
+};
+
+/* What a simulation event does at its node */
+enum SimEventType {
+    SIM_OGM_TIMER,      // Originate an OGM
+    SIM_TRANSMIT,       // Rebroadcast a forwarded OGM
+    SIM_RECEIVE,        // Deliver an OGM
+    SIM_PURGE,          // Purge the routing table
+    SIM_RECOMPUTE       // Run a batched route recompute
+};
+
+/*
+ * Events are totally ordered by (time, node, src, seq), where seq counts
+ * the events src has scheduled. The order depends only on what each
+ * node did, never on the order events were inserted, so any execution
+ * that respects it produces the same run.
+ */
+struct SimEvent {
+    double time_;
+    SimAddr node_;              // Node the event happens at
+    SimAddr src_;               // Node that scheduled it
+    uint64_t seq_;
+    uint8_t type_;
+    CoreOgm<SimAddr> ogm_;      // SIM_TRANSMIT and SIM_RECEIVE
+
+    bool operator>(const SimEvent &o) const {
+        if (time_ != o.time_)
+            return time_ > o.time_;
+        if (node_ != o.node_)
+            return node_ > o.node_;
+        if (src_ != o.src_)
+            return src_ > o.src_;
+        return seq_ > o.seq_;
+    }
+};
+
+typedef std::priority_queue<SimEvent, std::vector<SimEvent>,
+                            std::greater<SimEvent> > SimEventQueue;
+
+/* Wall-clock seconds since an arbitrary start */
+inline double wallTime() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* Resident set size of this process, 0 if unknown */
+inline size_t residentBytes() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return (n == 2) ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+#endif /* __batman_sim_h__ */
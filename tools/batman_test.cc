@@ -0,0 +1,91 @@
+/*
+ * batman_test.cc
+ * B.A.T.M.A.N. Protocol Core Checks
+ *
+ * Small scenarios run against the protocol core on a virtual clock;
+ * each prints its name and PASS or FAIL. Exits non-zero if any failed.
+ *
+ * usage: batman_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "batman_sim.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,      \
+                    __LINE__, #cond);                                   \
+            ok = false;                                                 \
+        }                                                               \
+    } while (0)
+
+static void report(const char *name, bool ok) {
+    printf("%-32s %s\n", name, ok ? "PASS" : "FAIL");
+    if (!ok)
+        failures++;
+}
+
+/* ===== HNA ===== */
+
+/* Two gateways announce 0/0; one withdrawing leaves the other's route */
+static void testSharedPrefix() {
+    bool ok = true;
+    double now = 0;
+    SimCore core((VirtualClock(&now)));
+    core.setAddress(100);
+
+    SimAddr gw1 = 1, gw2 = 2, via1 = 11, via2 = 12;
+    core.updateNeighborRanking(gw1, via1, 1, TTL_MAX - 1);
+    core.updateNeighborRanking(gw2, via2, 1, TTL_MAX - 1);
+    core.addHNA(gw1, 0, 0);
+    core.addHNA(gw2, 0, 0);
+    CHECK(core.fib().prefixes() == 1);
+    CHECK(core.lookupHNA(0x0a000001) != SimAddr());
+
+    core.removeHNA(gw2);
+    CHECK(core.lookupHNA(0x0a000001) == via1);
+    core.addHNA(gw2, 0, 0);
+    core.removeHNA(gw1);
+    CHECK(core.lookupHNA(0x0a000001) == via2);
+    core.removeHNA(gw2);
+    CHECK(core.lookupHNA(0x0a000001) == SimAddr());
+    CHECK(core.fib().prefixes() == 0);
+    report("hna_shared_prefix", ok);
+}
+
+/* Withdrawing a prefix hands its slots back to the covering prefix */
+static void testPrefixWithdraw() {
+    bool ok = true;
+    PrefixTrie<SimAddr> trie;
+    trie.insert(0x0a000000, 8, 1);
+    trie.insert(0x0a010000, 16, 2);
+    trie.insert(0x0a010000, 20, 3);
+    trie.insert(0x0a010100, 24, 4);
+
+    const PrefixTrie<SimAddr>::Announcers *a = trie.lookup(0x0a010105);
+    CHECK(a != NULL && (*a)[0] == 4);
+    trie.remove(0x0a010100, 24, 4);
+    a = trie.lookup(0x0a010105);
+    CHECK(a != NULL && (*a)[0] == 3);
+    trie.remove(0x0a010000, 20, 3);
+    a = trie.lookup(0x0a010105);
+    CHECK(a != NULL && (*a)[0] == 2);
+    a = trie.lookup(0x0a020000);
+    CHECK(a != NULL && (*a)[0] == 1);
+    trie.remove(0x0a010000, 16, 2);
+    trie.remove(0x0a000000, 8, 1);
+    CHECK(trie.lookup(0x0a010105) == NULL);
+    CHECK(trie.size() == 0);
+    report("lpm_withdraw", ok);
+}
+
+int main() {
+    testSharedPrefix();
+    testPrefixWithdraw();
+    return failures == 0 ? 0 : 1;
+}